@@ -0,0 +1,35 @@
+#ifndef _ALLIANCE_HPP_
+#define _ALLIANCE_HPP_
+
+#include "api.h"
+#include "robot.h"
+
+// The field is mirrored across its center line, so autonomous routines are
+// written once for the red side and reflected for blue: left and right swap,
+// and every turn changes direction. Whatever doesn't mirror cleanly, because
+// the field elements or the robot aren't quite symmetric, is measured per side
+// and kept in the calibration table instead of in the routines.
+
+enum Alliance {
+	ALLIANCE_RED,
+	ALLIANCE_BLUE,
+	ALLIANCE_COUNT,
+};
+
+struct AllianceCalibration {
+	// Added to the size of the big side turns, in the direction of the turn.
+	// The small side turn was tuned the same for both sides and doesn't use it.
+	okapi::QAngle turn_bias;
+	// Added to the drive into the small goal zone before setting down a stack
+	okapi::QLength approach_offset;
+	// How far the rollers push the cubes out to reseat them after intaking
+	okapi::QLength roller_reseat;
+};
+
+extern const AllianceCalibration ALLIANCE_CALIBRATION[ALLIANCE_COUNT];
+
+// Returns a copy of the robot's interfaces as seen from the given side of the
+// field. The motor systems are shared with the original.
+RobotDeviceInterfaces alliance_robot(RobotDeviceInterfaces *robot, Alliance alliance);
+
+#endif // _ALLIANCE_HPP_
@@ -0,0 +1,69 @@
+#ifndef _BENCHMARK_HPP_
+#define _BENCHMARK_HPP_
+
+#include "api.h"
+#include "robot.h"
+
+// Microbenchmarks for the code that runs every control cycle. They run on the
+// brain, because that is the CPU the control loop has to fit on, and are
+// started from the selector's tools. Each result is printed and appended to
+// BENCHMARK_RESULTS_FILE with the commit it was built from, so runs from
+// different commits can be compared to catch a slower loop before a match.
+//
+// There is no host build of these. The Makefile only targets the brain, and
+// firmware/ (the PROS kernel and okapilib, which the filters, the simulator
+// and the motor layer are implemented in) is not checked in, so a Linux build
+// would first need host implementations of both libraries.
+
+extern const char *BENCHMARK_RESULTS_FILE;
+
+// git describe of the tree the program was built from, passed in by the
+// Makefile
+#ifndef GIT_VERSION
+#define GIT_VERSION "unknown"
+#endif
+
+// Stops the compiler from optimising away a result that is never used
+extern volatile double benchmark_sink;
+
+// Only a millisecond clock is available, so the iteration count is doubled
+// until a run takes at least this long
+const std::uint32_t BENCHMARK_MIN_TIME = 100; // ms
+
+void benchmark_record(const char *name, double nanoseconds);
+// Records a measurement that isn't a time per call, like a distance error
+void benchmark_record_value(const char *name, double value, const char *unit);
+
+// Opens and closes the results file around a set of benchmarks. Results are
+// still printed if there is no SD card.
+void benchmark_open();
+void benchmark_close();
+
+// Times fn and records the average time per call
+template<typename F>
+void benchmark(const char *name, F fn){
+	long iterations = 16;
+	std::uint32_t elapsed;
+	while(true){
+		std::uint32_t start = pros::millis();
+		for(long i = 0; i < iterations; i++){
+			fn();
+		}
+		elapsed = pros::millis() - start;
+		if(elapsed >= BENCHMARK_MIN_TIME){
+			break;
+		}
+		iterations *= 2;
+	}
+	benchmark_record(name, elapsed * 1e6 / iterations);
+}
+
+// Runs every benchmark. Motor commands are all zero velocity, but the robot
+// should be on a stand because the motor layer benchmarks talk to the real
+// motors.
+void run_benchmarks(RobotDeviceInterfaces *robot);
+
+// Defined next to the code they measure, which isn't visible from outside
+void benchmark_opcontrol(RobotDeviceInterfaces *robot);
+
+#endif // _BENCHMARK_HPP_
@@ -0,0 +1,60 @@
+#ifndef _CALIBRATION_HPP_
+#define _CALIBRATION_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include "pid_tuning.h"
+
+// Measurements that get retuned without a rebuild: the wheel sizes, the turn
+// scrub and the position loop gains. They are stored on the SD card as the raw
+// bytes of a Calibration, so initialize() loads them with one read and no
+// parsing. The tuning tools fill in their part and save the whole struct.
+//
+// A file written by a different version, one that fails its checksum, or one
+// for a robot with different gear trains is ignored, and the defaults from
+// ROBOT_CONFIG are used instead. The gear trains are compiled in as types, so
+// changing one still needs a rebuild.
+
+extern const char *CALIBRATION_FILE;
+
+const std::uint32_t CALIBRATION_MAGIC = 0x36383637; // "7686"
+// Bump whenever the layout of Calibration changes
+const std::uint16_t CALIBRATION_VERSION = 1;
+
+struct Calibration {
+	std::uint32_t magic;
+	std::uint16_t version;
+	std::uint16_t size;
+
+	double wheel_diameter; // inches
+	// Effective distance between the drive wheels, which is larger than the
+	// measured one when the wheels scrub through a turn
+	double inter_wheel_distance; // inches
+	double roller_radius; // inches
+
+	// Must match TrayGearRatio and ArmGearRatio
+	double tray_ratio, arm_ratio;
+
+	PositionGains position_gains[POSITION_MECHANISM_COUNT];
+
+	// Of every byte before it
+	std::uint32_t checksum;
+};
+
+// The calibration in use. Holds the defaults until load_calibration() is
+// called.
+extern Calibration calibration;
+
+// Loads the calibration from the SD card, keeping the defaults if there isn't
+// a valid one. Called by initialize() before the robot is built.
+void load_calibration();
+
+void save_calibration();
+
+// Spins the robot two turns in place and compares the encoder heading to the
+// gyro to find the effective inter wheel distance, then saves it. Needs a
+// working gyro. The new distance is used from the next start, so running it
+// again before then measures against the same distance and replaces the result.
+void calibrate_turn_scrub(RobotDeviceInterfaces *robot);
+
+#endif // _CALIBRATION_HPP_
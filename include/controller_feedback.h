@@ -0,0 +1,55 @@
+#ifndef _CONTROLLER_FEEDBACK_HPP_
+#define _CONTROLLER_FEEDBACK_HPP_
+
+#include "api.h"
+
+const int CONTROLLER_LINES = 3;
+const int CONTROLLER_COLUMNS = 15;
+
+enum FeedbackPriority {
+	FEEDBACK_LOW,
+	FEEDBACK_NORMAL,
+	FEEDBACK_HIGH,
+};
+
+// The V5 controller drops screen and rumble updates sent faster than about
+// one per 50ms, so nothing should call set_text or rumble directly from the
+// control loop. ControllerFeedback keeps the latest text for each line and a
+// pending rumble pattern, and a background task sends at most one update per
+// send period, highest priority first. Posting is cheap and never blocks on
+// the controller, so it can be done every tick.
+class ControllerFeedback {
+private:
+	struct Line {
+		char text[CONTROLLER_COLUMNS + 1];
+		char shown[CONTROLLER_COLUMNS + 1];
+		FeedbackPriority priority;
+		bool dirty;
+	};
+
+	pros::Controller *controller;
+	pros::Mutex mutex;
+	pros::Task *task;
+
+	Line lines[CONTROLLER_LINES];
+	int next_line; // round robin start among equal priority lines
+
+	char rumble_pattern[9];
+	bool rumble_pending;
+
+	static void task_fn(void *param);
+	void send_next();
+
+public:
+	ControllerFeedback(pros::Controller *controller);
+
+	// Replaces the pending text for a line. Text that is already on the screen
+	// is not sent again.
+	void set_line(int line, const char *text, FeedbackPriority priority = FEEDBACK_NORMAL);
+
+	// Queues a rumble pattern of '.', '-' and ' ', replacing any pattern that
+	// hasn't been sent yet. Rumbles are sent before any text.
+	void rumble(const char *pattern);
+};
+
+#endif // _CONTROLLER_FEEDBACK_HPP_
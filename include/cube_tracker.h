@@ -0,0 +1,94 @@
+#ifndef _CUBE_TRACKER_HPP_
+#define _CUBE_TRACKER_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include <vector>
+
+// Where vision frames come from. Objects are in the sensor's field of view
+// with (0, 0) at the center.
+class FrameSource {
+public:
+	// Copies up to capacity objects into objects, largest first, and returns
+	// how many were copied
+	virtual int read(pros::vision_object_s_t *objects, int capacity) = 0;
+};
+
+class VisionFrameSource final: public FrameSource {
+private:
+	pros::Vision vision;
+
+public:
+	VisionFrameSource(std::uint8_t port);
+
+	int read(pros::vision_object_s_t *objects, int capacity) override;
+};
+
+// Plays back frames from a text file, one frame per line and each object as
+// "x,y,width,height" separated by spaces, then repeats. The file can be a
+// recording or written by hand to test the tracker without a sensor.
+class RecordedFrameSource final: public FrameSource {
+private:
+	std::vector<std::vector<pros::vision_object_s_t>> frames;
+	int next_frame;
+
+public:
+	RecordedFrameSource(const char *path);
+
+	int read(pros::vision_object_s_t *objects, int capacity) override;
+};
+
+// The bearing of the cube the robot should drive to. Clockwise is positive,
+// matching the turn drive.
+class TargetTracker {
+public:
+	// Returns false if no cube has been seen steadily
+	virtual bool get_bearing(okapi::QAngle *bearing) = 0;
+};
+
+const int VISION_MAX_OBJECTS = 8;
+const int VISION_MAX_TRACKS = 8;
+
+// Follows cubes from frame to frame, in its own task once started. Each object in a frame is
+// matched to the nearest track close enough to it, unmatched objects start new
+// tracks, and tracks that go unseen for a few frames are dropped. The target
+// is the widest, and so closest, track that has been seen for several frames,
+// so a single false detection can't steer the robot.
+class CubeTracker final: public TargetTracker {
+private:
+	struct Track {
+		bool active;
+		float x, width; // pixels
+		int seen, missed; // frames
+	};
+
+	FrameSource *source;
+	pros::vision_object_s_t objects[VISION_MAX_OBJECTS];
+	Track tracks[VISION_MAX_TRACKS];
+
+	pros::Mutex target_mutex;
+	bool target_valid;
+	okapi::QAngle target_bearing;
+
+	pros::Task *task;
+
+	static void task_fn(void *param);
+
+public:
+	CubeTracker(FrameSource *source);
+
+	// Reads and tracks one frame. This is called periodically by the tracker
+	// task once start() is called, or can be called directly to run the
+	// tracker over recorded frames.
+	void update();
+	void start();
+
+	bool get_bearing(okapi::QAngle *bearing) override;
+};
+
+// Drives forward the given distance, steering towards the tracked cube when
+// there is one. Combine it with IntakeMonitor::wait_for_cubes to stop as soon
+// as the cubes are in.
+BlockCommand *drive_to_cube(RobotDeviceInterfaces *robot, okapi::QLength distance, okapi::QAngularSpeed speed);
+
+#endif // _CUBE_TRACKER_HPP_
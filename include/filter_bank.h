@@ -0,0 +1,265 @@
+#ifndef _FILTER_BANK_HPP_
+#define _FILTER_BANK_HPP_
+
+#include "okapi/api/filter/filter.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FILTER_BANK_SIMD
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define FILTER_BANK_SIMD
+#endif
+
+// Filters N channels together, such as the currents of every motor, with the
+// same chaining as okapi's ComposableFilter. okapi filters cost a virtual call
+// per sample per channel. Here each stage is one call per tick that runs over
+// all channels, four at a time where it can. Values are floats, which is more
+// precision than any of the motor readings have, and fit four to a vector.
+
+// Four channel operations for the stages' loops: NEON on the brain, SSE on a
+// PC. Without either, and for the channels left over when N isn't a multiple
+// of four, the stages fall back to plain loops.
+namespace filter_bank_simd {
+#if defined(__ARM_NEON)
+typedef float32x4_t vec;
+inline vec load(const float *p){ return vld1q_f32(p); }
+inline void store(float *p, vec v){ vst1q_f32(p, v); }
+inline vec splat(float x){ return vdupq_n_f32(x); }
+inline vec add(vec a, vec b){ return vaddq_f32(a, b); }
+inline vec sub(vec a, vec b){ return vsubq_f32(a, b); }
+inline vec mul(vec a, vec b){ return vmulq_f32(a, b); }
+inline vec min(vec a, vec b){ return vminq_f32(a, b); }
+inline vec max(vec a, vec b){ return vmaxq_f32(a, b); }
+#elif defined(__SSE__)
+typedef __m128 vec;
+inline vec load(const float *p){ return _mm_loadu_ps(p); }
+inline void store(float *p, vec v){ _mm_storeu_ps(p, v); }
+inline vec splat(float x){ return _mm_set1_ps(x); }
+inline vec add(vec a, vec b){ return _mm_add_ps(a, b); }
+inline vec sub(vec a, vec b){ return _mm_sub_ps(a, b); }
+inline vec mul(vec a, vec b){ return _mm_mul_ps(a, b); }
+inline vec min(vec a, vec b){ return _mm_min_ps(a, b); }
+inline vec max(vec a, vec b){ return _mm_max_ps(a, b); }
+#endif
+
+const std::size_t WIDTH = 4;
+}
+
+template<std::size_t N>
+class FilterBankStage {
+public:
+	virtual ~FilterBankStage() = default;
+
+	// Filters every channel in place
+	virtual void filter(float *values) = 0;
+
+	// Restarts one channel's history as if it had only ever read value
+	virtual void reset(std::size_t channel, float value) = 0;
+};
+
+// Exponential moving average, like okapi::EmaFilter
+template<std::size_t N>
+class EmaBankStage: public FilterBankStage<N> {
+private:
+	float alpha;
+	float output[N] = {};
+
+public:
+	explicit EmaBankStage(float alpha): alpha(alpha) {}
+
+	void filter(float *values) override {
+		std::size_t i = 0;
+#ifdef FILTER_BANK_SIMD
+		using namespace filter_bank_simd;
+		vec alpha = splat(this->alpha);
+		for(; i + WIDTH <= N; i += WIDTH){
+			vec output = load(this->output + i);
+			output = add(output, mul(alpha, sub(load(values + i), output)));
+			store(this->output + i, output);
+			store(values + i, output);
+		}
+#endif
+		for(; i < N; i++){
+			this->output[i] += this->alpha * (values[i] - this->output[i]);
+			values[i] = this->output[i];
+		}
+	}
+
+	void reset(std::size_t channel, float value) override {
+		this->output[channel] = value;
+	}
+};
+
+// Mean of the last Size readings, like okapi::AverageFilter
+template<std::size_t N, std::size_t Size>
+class AverageBankStage: public FilterBankStage<N> {
+private:
+	float history[Size][N] = {};
+	float sum[N] = {};
+	std::size_t index = 0;
+
+public:
+	void filter(float *values) override {
+		// Multiplied rather than divided, as NEON has no divide
+		const float scale = 1.0f / Size;
+		float *oldest = this->history[this->index];
+		std::size_t i = 0;
+#ifdef FILTER_BANK_SIMD
+		using namespace filter_bank_simd;
+		vec scales = splat(scale);
+		for(; i + WIDTH <= N; i += WIDTH){
+			vec value = load(values + i);
+			vec sum = add(load(this->sum + i), sub(value, load(oldest + i)));
+			store(this->sum + i, sum);
+			store(oldest + i, value);
+			store(values + i, mul(sum, scales));
+		}
+#endif
+		for(; i < N; i++){
+			this->sum[i] += values[i] - oldest[i];
+			oldest[i] = values[i];
+			values[i] = this->sum[i] * scale;
+		}
+		this->index = (this->index + 1) % Size;
+	}
+
+	void reset(std::size_t channel, float value) override {
+		for(std::size_t j = 0; j < Size; j++){
+			this->history[j][channel] = value;
+		}
+		this->sum[channel] = value * Size;
+	}
+};
+
+// Median of the last Size readings, like okapi::MedianFilter. A median of
+// three is a min/max network over all channels at once. Longer ones sort each
+// channel on its own, which is cheap while Size is small.
+template<std::size_t N, std::size_t Size>
+class MedianBankStage: public FilterBankStage<N> {
+private:
+	float history[Size][N] = {};
+	std::size_t index = 0;
+
+	static float median3(float a, float b, float c){
+		return std::max(std::min(a, b), std::min(std::max(a, b), c));
+	}
+
+public:
+	void filter(float *values) override {
+		std::copy(values, values + N, this->history[this->index]);
+		this->index = (this->index + 1) % Size;
+
+		std::size_t i = 0;
+		if(Size == 3){
+#ifdef FILTER_BANK_SIMD
+			using namespace filter_bank_simd;
+			for(; i + WIDTH <= N; i += WIDTH){
+				vec a = load(this->history[0] + i);
+				vec b = load(this->history[1 % Size] + i);
+				vec c = load(this->history[2 % Size] + i);
+				store(values + i, max(min(a, b), min(max(a, b), c)));
+			}
+#endif
+			for(; i < N; i++){
+				values[i] = median3(this->history[0][i], this->history[1 % Size][i], this->history[2 % Size][i]);
+			}
+			return;
+		}
+
+		for(; i < N; i++){
+			float sorted[Size];
+			for(std::size_t j = 0; j < Size; j++){
+				sorted[j] = this->history[j][i];
+			}
+			std::nth_element(sorted, sorted + Size / 2, sorted + Size);
+			values[i] = sorted[Size / 2];
+		}
+	}
+
+	void reset(std::size_t channel, float value) override {
+		for(std::size_t j = 0; j < Size; j++){
+			this->history[j][channel] = value;
+		}
+	}
+};
+
+// Runs an okapi filter per channel, for a stage with no bank version like
+// okapi::DemaFilter, so any ComposableFilter chain can be moved over as it is.
+// It costs what the okapi filters cost.
+template<std::size_t N>
+class OkapiBankStage: public FilterBankStage<N> {
+private:
+	std::function<std::shared_ptr<okapi::Filter>()> make;
+	std::shared_ptr<okapi::Filter> filters[N];
+
+public:
+	// make is called for a new filter for each channel
+	explicit OkapiBankStage(std::function<std::shared_ptr<okapi::Filter>()> make): make(make) {
+		for(std::size_t i = 0; i < N; i++){
+			this->filters[i] = make();
+		}
+	}
+
+	void filter(float *values) override {
+		for(std::size_t i = 0; i < N; i++){
+			values[i] = this->filters[i]->filter(values[i]);
+		}
+	}
+
+	// okapi filters can't be set to a value, so the channel gets a new filter
+	// that has read it once
+	void reset(std::size_t channel, float value) override {
+		this->filters[channel] = this->make();
+		this->filters[channel]->filter(value);
+	}
+};
+
+template<std::size_t N>
+class FilterBank {
+protected:
+	std::vector<std::shared_ptr<FilterBankStage<N>>> filters;
+	float output[N] = {};
+
+public:
+	FilterBank() = default;
+
+	FilterBank(const std::initializer_list<std::shared_ptr<FilterBankStage<N>>> &ilist): filters(ilist) {}
+
+	// Passes one reading per channel through each stage in sequence, and
+	// returns the outputs of the last stage
+	const float *filter(const float *readings){
+		std::copy(readings, readings + N, this->output);
+		for(auto &stage: this->filters){
+			stage->filter(this->output);
+		}
+		return this->output;
+	}
+
+	const float *getOutput() const {
+		return this->output;
+	}
+
+	float getOutput(std::size_t channel) const {
+		return this->output[channel];
+	}
+
+	void addFilter(const std::shared_ptr<FilterBankStage<N>> &ifilter){
+		this->filters.push_back(ifilter);
+	}
+
+	void reset(std::size_t channel, float value){
+		for(auto &stage: this->filters){
+			stage->reset(channel, value);
+		}
+		this->output[channel] = value;
+	}
+};
+
+#endif // _FILTER_BANK_HPP_
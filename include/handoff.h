@@ -0,0 +1,90 @@
+#ifndef _HANDOFF_HPP_
+#define _HANDOFF_HPP_
+
+#include "api.h"
+#include <atomic>
+
+// Ways for tasks to hand data to each other without a mutex, so a task that
+// drives motors never waits on a slower one.
+
+// A fixed size queue with exactly one task pushing and one task popping. The
+// producer only writes tail and the consumer only writes head, so neither
+// side ever waits. The indexes count up forever and wrap, which is why the
+// size has to be a power of two.
+template<typename T, std::uint32_t N>
+class SpscQueue {
+private:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+	T items[N];
+	std::atomic<std::uint32_t> head; // next item to pop
+	std::atomic<std::uint32_t> tail; // next slot to push into
+
+public:
+	SpscQueue(): head(0), tail(0) {}
+
+	// Returns false, dropping the item, if the queue is full
+	bool push(const T &item){
+		std::uint32_t tail = this->tail.load(std::memory_order_relaxed);
+		if(tail - this->head.load(std::memory_order_acquire) == N){
+			return false;
+		}
+		this->items[tail % N] = item;
+		this->tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Returns false if the queue is empty
+	bool pop(T *item){
+		std::uint32_t head = this->head.load(std::memory_order_relaxed);
+		if(head == this->tail.load(std::memory_order_acquire)){
+			return false;
+		}
+		*item = this->items[head % N];
+		this->head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+// The latest value of something one task measures and any number of tasks
+// read. The writer makes the sequence odd while it copies the value in, and a
+// reader that sees an odd sequence, or a different one after its copy, reads
+// again. T has to be plain data, since a reader can copy it half written.
+//
+// The brain runs every task on one core, so a reader that preempts the writer
+// mid-publish would spin forever if it never let the writer run. A retry
+// sleeps for a tick instead, which only happens when the two collide.
+template<typename T>
+class Seqlock {
+private:
+	std::atomic<std::uint32_t> sequence;
+	T value;
+
+public:
+	Seqlock(): sequence(0), value() {}
+
+	// Only one task may publish
+	void publish(const T &value){
+		std::uint32_t sequence = this->sequence.load(std::memory_order_relaxed);
+		this->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		this->value = value;
+		this->sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	T read(){
+		while(true){
+			std::uint32_t before = this->sequence.load(std::memory_order_acquire);
+			T copy = this->value;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			std::uint32_t after = this->sequence.load(std::memory_order_relaxed);
+
+			if(before == after && (before & 1) == 0){
+				return copy;
+			}
+			pros::delay(1);
+		}
+	}
+};
+
+#endif // _HANDOFF_HPP_
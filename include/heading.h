@@ -0,0 +1,87 @@
+#ifndef _HEADING_HPP_
+#define _HEADING_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include "okapi/api/filter/ekfFilter.hpp"
+#include <functional>
+
+// A source of the robot's absolute yaw. Clockwise is positive, matching the
+// turn drive.
+class YawSensor {
+public:
+	// Returns false, leaving yaw unchanged, if the sensor couldn't be read
+	virtual bool get_yaw(okapi::QAngle *yaw) = 0;
+};
+
+class GyroYawSensor final: public YawSensor {
+private:
+	pros::ADIGyro gyro;
+	double direction;
+
+public:
+	// Constructing the gyro starts its calibration, so the robot must be still
+	GyroYawSensor(std::uint8_t port, bool reversed);
+
+	bool get_yaw(okapi::QAngle *yaw) override;
+};
+
+// Stands in for a gyro when there isn't one, such as in the simulator. It
+// reads a true yaw and adds the drift and quantisation of the real sensor.
+class SimulatedGyro final: public YawSensor {
+private:
+	std::function<okapi::QAngle()> truth;
+	double drift; // degrees per second
+	std::uint32_t start_time;
+
+public:
+	SimulatedGyro(std::function<okapi::QAngle()> truth, double drift = 0.05);
+
+	bool get_yaw(okapi::QAngle *yaw) override;
+};
+
+// Estimates the robot's heading from the drive encoders and a gyro. Encoder
+// yaw is smooth but reads too large when the wheels scrub through a turn, and
+// the gyro is true on average but noisy and quantised. A Kalman filter
+// predicts with each encoder yaw step and corrects towards the gyro.
+//
+// The gyro isn't fused until it has read something other than zero. If it
+// still hasn't once the encoders have turned a fair way, it is assumed to be
+// unplugged and the encoders are used alone. A single failed read only skips
+// that correction.
+class HeadingEstimator {
+private:
+	LinearMotorSystem *left_drive, *right_drive;
+	okapi::QLength inter_wheel_distance;
+	YawSensor *gyro;
+	bool gyro_healthy;
+	bool gyro_responded;
+
+	okapi::EKFFilter filter;
+	okapi::QAngle start_encoder_yaw;
+	okapi::QAngle previous_encoder_yaw;
+	double skipped_step; // degrees of encoder yaw not yet given to the filter
+	double encoder_travel; // degrees turned either way, while the gyro is checked
+	volatile double heading; // degrees
+
+	pros::Task *task;
+
+	static void task_fn(void *param);
+
+public:
+	// gyro can be NULL to use the encoders alone
+	HeadingEstimator(LinearMotorSystem *left_drive, LinearMotorSystem *right_drive,
+		okapi::QLength inter_wheel_distance, YawSensor *gyro);
+
+	// Runs one filter step. This is called periodically by the estimator task.
+	void update();
+
+	okapi::QAngle get_heading();
+	okapi::QAngle get_encoder_heading();
+	// The distance encoder heading is worked out with, which is what the
+	// calibration held when the estimator was made
+	okapi::QLength get_inter_wheel_distance();
+	bool is_gyro_healthy();
+};
+
+#endif // _HEADING_HPP_
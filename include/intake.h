@@ -0,0 +1,80 @@
+#ifndef _INTAKE_HPP_
+#define _INTAKE_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include "filter_bank.h"
+#include <functional>
+#include <vector>
+
+enum IntakeState {
+	INTAKE_IDLE,      // Rollers are stopped or spinning outwards
+	INTAKE_RUNNING,   // Rollers are intaking with nothing in them
+	INTAKE_INGESTING, // A cube is being pulled through the rollers
+	INTAKE_JAMMED,    // The rollers are stalled
+	INTAKE_FULL,      // The tray can't take another cube
+};
+
+enum IntakeEvent {
+	INTAKE_CUBE_INGESTED,
+	INTAKE_JAM,
+	INTAKE_JAM_CLEARED,
+	INTAKE_TRAY_FULL,
+};
+
+// Channels of the intake's filter bank
+enum IntakeChannel {
+	INTAKE_CURRENT,        // mA
+	INTAKE_VELOCITY_RATIO, // actual roller velocity over target velocity
+	INTAKE_CHANNEL_COUNT,
+};
+
+// The IntakeMonitor watches the current draw and velocity of the roller motors
+// to estimate what the intake is doing. A cube being pulled in shows up as a
+// short current spike with a small velocity dip, a jam as a long stall, and a
+// full tray as a sustained load that never clears. Rollers spinning up from
+// rest look loaded too, so nothing is detected until they reach speed.
+// Listeners are called from the monitor task whenever the estimate changes.
+class IntakeMonitor {
+private:
+	pros::Motor *left_motor, *right_motor;
+	pros::Task *task;
+
+	std::vector<std::function<void(IntakeEvent)>> listeners;
+
+	volatile IntakeState state;
+	volatile int cube_count;
+
+	FilterBank<INTAKE_CHANNEL_COUNT> filters;
+	int loaded_ticks;
+	int stalled_ticks;
+	int spin_up_ticks;
+	bool spun_up; // loads are only looked for once the rollers are up to speed
+
+	// Held while the state or cube count changes
+	pros::Mutex mutex;
+
+	static void task_fn(void *param);
+	void step(bool running, double target, const float *filtered);
+	void emit(IntakeEvent event);
+	void set_state(IntakeState state);
+
+public:
+	IntakeMonitor(pros::Motor *left_motor, pros::Motor *right_motor);
+
+	// Runs one estimator step. This is called periodically by the monitor task.
+	void update();
+
+	IntakeState get_state();
+	int get_cube_count();
+	void reset_cube_count();
+
+	// Listeners are not synchronised with the monitor task, so they should be
+	// added during initialize().
+	void add_listener(std::function<void(IntakeEvent)> listener);
+
+	// Finishes once count more cubes have been ingested, or the tray is full.
+	BlockCommand *wait_for_cubes(int count = 1);
+};
+
+#endif // _INTAKE_HPP_
@@ -56,6 +56,20 @@
 
 #ifdef __cplusplus
 #include "robot.h"
+#include "robot_config.h"
+#include "intake.h"
+#include "telemetry.h"
+#include "controller_feedback.h"
+#include "power.h"
+#include "profiler.h"
+#include "heading.h"
+#include "cube_tracker.h"
+#include "wall_sensor.h"
+#include "supervisor.h"
+
+// The motor systems take okapi units, so the unit literals (36_in, 100_rpm,
+// 0.25_rot) are used everywhere.
+using namespace okapi::literals;
 #endif
 
 /**
@@ -69,6 +83,7 @@ extern "C" {
 
 extern RobotDeviceInterfaces *global_robot;
 extern pros::Controller *global_controller;
+extern ControllerFeedback *global_feedback;
 
 void autonomous(void);
 void initialize(void);
@@ -76,6 +91,21 @@ void disabled(void);
 void competition_initialize(void);
 void opcontrol(void);
 
+// Stops any driver macro that is still running, since unlike the opcontrol
+// task the macro task isn't stopped when the robot is disabled
+void stop_driver_macros(void);
+
+// Compiles the autonomous script on the SD card
+void load_autonomous_script(void);
+// Restores the autonomous selection saved on the SD card
+void load_autonomous_selection(void);
+const char *get_autonomous_name(void);
+
+// The robot driver control runs on, called each time it starts. While the
+// simulated driver control tool is selected this resets the simulator and
+// returns the robot built on it, and otherwise it returns global_robot.
+RobotDeviceInterfaces *driver_control_robot(void);
+
 #ifdef __cplusplus
 }
 #endif
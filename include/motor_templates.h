@@ -0,0 +1,237 @@
+#ifndef _MOTOR_TEMPLATES_HPP_
+#define _MOTOR_TEMPLATES_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include <algorithm>
+
+// Motor systems composed as templates. Every layer holds the next by its
+// concrete type and the motor ports are template parameters, so a call like
+// straight_drive.move_velocity() inlines down to motor_move_velocity() calls
+// on constant ports, with no virtual calls in between. The MotorSystem
+// interfaces in robot.h wrap these through the adapters at the bottom, so
+// autonomous routines and scripts see the same API as before, at the cost of
+// one virtual call at the top.
+
+// How close a motor has to be to its target for a move to be finished
+const double MOTOR_TARGET_SIZE = 0.015; // motor rotations
+
+// Free speed of each motor cartridge
+inline okapi::QAngularSpeed gearset_max_velocity(pros::motor_gearset_e_t gearset){
+	switch(gearset){
+		case pros::E_MOTOR_GEARSET_36: return 100 * okapi::rpm;
+		case pros::E_MOTOR_GEARSET_06: return 600 * okapi::rpm;
+		default: return 200 * okapi::rpm;
+	}
+}
+
+// A motor called through the PROS C API. The cartridge, direction and encoder
+// units are set on the port when its pros::Motor is constructed, and stay set
+// for these calls.
+template<std::uint8_t Port>
+class PortMotor {
+public:
+	static void move_velocity(double velocity){
+		pros::c::motor_move_velocity(Port, velocity);
+	}
+
+	static void move_relative(double position, double velocity){
+		pros::c::motor_move_relative(Port, position, velocity);
+	}
+
+	static double get_position(){
+		return pros::c::motor_get_position(Port);
+	}
+
+	static double get_actual_velocity(){
+		return pros::c::motor_get_actual_velocity(Port);
+	}
+
+	static pros::motor_gearset_e_t get_gearing(){
+		return pros::c::motor_get_gearing(Port);
+	}
+};
+
+template<typename Motor>
+class PortBlockCommand: public BlockCommand {
+private:
+	double target_position;
+
+public:
+	virtual bool check() override {
+		return fabs(Motor::get_position() - this->target_position) < MOTOR_TARGET_SIZE;
+	}
+
+	PortBlockCommand(double target_position){
+		this->target_position = target_position;
+	}
+};
+
+// A motor driving a wheel, or anything else with a surface, of the given
+// diameter
+template<typename Motor>
+class Wheel {
+private:
+	okapi::QLength diameter;
+	okapi::QAngularSpeed speed;
+
+public:
+	void move_velocity(okapi::QAngularSpeed velocity){
+		Motor::move_velocity(to_rpm(velocity));
+	}
+
+	BlockCommand *move_distance(okapi::QLength distance){
+		double target_distance = to_rotations(wheel_angle(distance, this->diameter));
+		double target_position = Motor::get_position() + target_distance;
+		Motor::move_relative(target_distance, to_rpm(this->speed));
+
+		BlockCommand *command = new PortBlockCommand<Motor>(target_position);
+		if(to_rpm(this->speed) > 0){
+			command->deadline = command_deadline(fabs(target_distance) / to_rpm(this->speed) * 60000);
+		}
+		return command;
+	}
+
+	void set_speed(okapi::QAngularSpeed speed){
+		this->speed = speed;
+	}
+
+	okapi::QLength get_distance(){
+		return arc_length(Motor::get_position() * rotation, this->diameter);
+	}
+
+	okapi::QSpeed get_linear_velocity(){
+		return surface_speed(Motor::get_actual_velocity() * okapi::rpm, this->diameter);
+	}
+
+	okapi::QAngularSpeed get_max_velocity(){
+		return gearset_max_velocity(Motor::get_gearing());
+	}
+
+	okapi::QSpeed get_max_linear_velocity(){
+		return surface_speed(this->get_max_velocity(), this->diameter);
+	}
+
+	void move_linear_velocity(okapi::QSpeed velocity){
+		Motor::move_velocity(to_rpm(wheel_speed(velocity, this->diameter)));
+	}
+
+	Wheel(okapi::QLength diameter, okapi::QAngularSpeed speed = 100 * okapi::rpm){
+		this->diameter = diameter;
+		this->speed = speed;
+	}
+};
+
+// Two wheels that move together, like the two sides of the drive going
+// straight or the two rollers
+template<typename Left, typename Right>
+class WheelPair {
+public:
+	Left left;
+	Right right;
+
+	void move_velocity(okapi::QAngularSpeed velocity){
+		this->left.move_velocity(velocity);
+		this->right.move_velocity(velocity);
+	}
+
+	BlockCommand *move_distance(okapi::QLength distance){
+		return both(this->left.move_distance(distance), this->right.move_distance(distance));
+	}
+
+	void set_speed(okapi::QAngularSpeed speed){
+		this->left.set_speed(speed);
+		this->right.set_speed(speed);
+	}
+
+	okapi::QLength get_distance(){
+		return (this->left.get_distance() + this->right.get_distance()) / 2;
+	}
+
+	okapi::QSpeed get_linear_velocity(){
+		return (this->left.get_linear_velocity() + this->right.get_linear_velocity()) / 2;
+	}
+
+	okapi::QAngularSpeed get_max_velocity(){
+		return std::min(this->left.get_max_velocity(), this->right.get_max_velocity());
+	}
+
+	okapi::QSpeed get_max_linear_velocity(){
+		return std::min(this->left.get_max_linear_velocity(), this->right.get_max_linear_velocity());
+	}
+
+	void move_linear_velocity(okapi::QSpeed velocity){
+		this->left.move_linear_velocity(velocity);
+		this->right.move_linear_velocity(velocity);
+	}
+
+	WheelPair(okapi::QLength diameter): left(diameter), right(diameter) {}
+};
+
+template<typename System>
+class LinearAdapter final: public LinearMotorSystem {
+private:
+	System *system;
+
+public:
+	void move_velocity(okapi::QAngularSpeed velocity) override {
+		this->system->move_velocity(velocity);
+	}
+
+	BlockCommand *move_distance(okapi::QLength distance) override {
+		return this->system->move_distance(distance);
+	}
+
+	void set_speed(okapi::QAngularSpeed speed) override {
+		this->system->set_speed(speed);
+	}
+
+	okapi::QLength get_distance() override {
+		return this->system->get_distance();
+	}
+
+	okapi::QAngularSpeed get_max_velocity() override {
+		return this->system->get_max_velocity();
+	}
+
+	okapi::QSpeed get_linear_velocity() override {
+		return this->system->get_linear_velocity();
+	}
+
+	okapi::QSpeed get_max_linear_velocity() override {
+		return this->system->get_max_linear_velocity();
+	}
+
+	void move_linear_velocity(okapi::QSpeed velocity) override {
+		this->system->move_linear_velocity(velocity);
+	}
+
+	LinearAdapter(System *system){
+		this->system = system;
+	}
+};
+
+template<typename System>
+class AngularAdapter final: public AngularMotorSystem {
+private:
+	System *system;
+
+public:
+	void move_velocity(okapi::QAngularSpeed velocity) override {
+		this->system->move_velocity(velocity);
+	}
+
+	BlockCommand *move_angle(okapi::QAngle angle) override {
+		return this->system->move_angle(angle);
+	}
+
+	void set_speed(okapi::QAngularSpeed speed) override {
+		this->system->set_speed(speed);
+	}
+
+	AngularAdapter(System *system){
+		this->system = system;
+	}
+};
+
+#endif // _MOTOR_TEMPLATES_HPP_
@@ -0,0 +1,34 @@
+#ifndef _OKAPI_DRIVE_HPP_
+#define _OKAPI_DRIVE_HPP_
+
+#include "api.h"
+#include "robot.h"
+
+// The drive can run on either of two backends. The native one is the template
+// motor stack in motor_templates.h. The okapi one is built on okapi's
+// SkidSteerModel: straight moves follow an AsyncMotionProfileController
+// profile and turns go through ChassisControllerIntegrated. Both read the same
+// encoders, so everything that only measures the drive (get_distance, the
+// heading estimator, telemetry) is shared between them. The okapi backend
+// drives whatever pros::Motor objects the robot was built on, so it runs on
+// the simulator too.
+
+enum DriveBackend {
+	DRIVE_BACKEND_NATIVE,
+	DRIVE_BACKEND_OKAPI,
+	DRIVE_BACKEND_COUNT,
+};
+
+extern const char *DRIVE_BACKEND_NAMES[DRIVE_BACKEND_COUNT];
+
+// Returns a copy of the robot's interfaces with straight_drive and turn_drive
+// on the given backend. The okapi backend is built the first time it is asked
+// for on a robot's drive motors, and shared after that.
+RobotDeviceInterfaces drive_backend_robot(RobotDeviceInterfaces *robot, DriveBackend backend);
+
+// Runs the same drive segments on each backend and records how long each took
+// and how far off it finished. On the real robot it needs a clear 3 foot
+// square of floor.
+void compare_drive_backends(RobotDeviceInterfaces *robot);
+
+#endif // _OKAPI_DRIVE_HPP_
@@ -0,0 +1,52 @@
+#ifndef _PID_TUNING_HPP_
+#define _PID_TUNING_HPP_
+
+#include "api.h"
+#include "robot.h"
+
+// The arm and tray finish every move on the motor firmware's position loop,
+// which has default gains that are slow for the tray and overshoot on the arm
+// under load. These tune the gains with okapi's PIDTuner, a particle swarm
+// search that runs trial moves on the mechanism, then push the best gains to
+// the motors. The gains have to be scaled into the firmware's units, so they
+// are only kept if a move on the firmware loop with them settles faster than
+// with the gains the motors had. Tune in the simulator first to check the
+// search ranges, then on the robot, which saves gains that pass in the
+// calibration so they are applied at every start.
+
+enum PositionMechanism {
+	POSITION_ARM,
+	POSITION_TRAY,
+	POSITION_MECHANISM_COUNT,
+};
+
+// In okapi's units: fraction of full voltage per motor degree of error
+struct PositionGains {
+	double kp, ki, kd;
+	bool tuned; // false to leave the firmware defaults
+};
+
+// Runs the search on the mechanism, which moves up and back by its test
+// travel many times, and returns the best gains found. Takes a few minutes.
+// The gains aren't marked tuned if the mechanism couldn't get back to its
+// start between trials.
+PositionGains autotune_position_gains(RobotDeviceInterfaces *robot, PositionMechanism mechanism);
+
+// Moves the mechanism by its test travel on the firmware loop with the gains
+// it has, then with the given gains. The given gains are left applied if they
+// settled, without overshooting, no slower than the old ones. Otherwise the
+// old ones are put back and this returns false.
+bool verify_position_gains(RobotDeviceInterfaces *robot, PositionMechanism mechanism, const PositionGains &gains);
+
+// Sends the gains to the mechanism's motors
+void apply_position_gains(RobotDeviceInterfaces *robot, PositionMechanism mechanism, const PositionGains &gains);
+
+// Applies the gains from the calibration, if any have been tuned
+void load_position_gains(RobotDeviceInterfaces *robot);
+
+// Tunes the arm then the tray and applies the results that pass verification.
+// Those gains are only saved if save is set, so a run in the simulator, where
+// the firmware gains have no effect, doesn't replace them.
+void tune_position_gains(RobotDeviceInterfaces *robot, bool save);
+
+#endif // _PID_TUNING_HPP_
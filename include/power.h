@@ -0,0 +1,91 @@
+#ifndef _POWER_HPP_
+#define _POWER_HPP_
+
+#include "api.h"
+#include "filter_bank.h"
+#include <functional>
+
+enum PowerGroup {
+	POWER_DRIVE,
+	POWER_ARM,
+	POWER_TRAY,
+	POWER_ROLLER,
+	POWER_GROUP_COUNT,
+};
+
+enum PowerMode {
+	POWER_DRIVING,
+	POWER_STACKING,
+};
+
+// The PowerManager shares a global current budget between all of the motors.
+// Each motor's share depends on what the robot is doing (the drive gets
+// priority while driving, the tray while stacking), whether it is working at
+// all, and how hot it is. Limits are derated before a motor reaches its
+// thermal cutoff, so performance drops off gradually instead of a motor
+// stopping mid-match.
+class PowerManager {
+private:
+	static const int MAX_MOTORS = 8;
+
+	struct ManagedMotor {
+		pros::Motor *motor;
+		PowerGroup group;
+		std::int32_t limit; // mA, last limit sent to the motor
+	};
+
+	ManagedMotor motors[MAX_MOTORS];
+	int motor_count;
+
+	// Every motor's current draw, with single reading spikes and failed
+	// reads filtered out. Channels past motor_count read 0.
+	FilterBank<MAX_MOTORS> currents;
+
+	pros::Motor *tray_motor;
+	std::function<bool()> tray_profile_active;
+	volatile PowerMode mode;
+	pros::Task *task;
+
+	static void task_fn(void *param);
+
+public:
+	PowerManager();
+
+	void add_motor(pros::Motor *motor, PowerGroup group);
+
+	// The robot is stacking while the tray runs its profile or is being moved
+	// by hand. The motor's target velocity can't tell, since the firmware keeps
+	// a non zero target while it holds the tray at the end of a profile.
+	void set_tray(pros::Motor *motor, std::function<bool()> profile_active);
+
+	// Samples the motors, and the battery if this manager was started first,
+	// and sends new current limits. This is called periodically by the power
+	// manager task once start() is called.
+	void update();
+	void start();
+
+	PowerMode get_mode();
+};
+
+// Battery compensation. Velocity commands below a motor's free speed are held
+// by the motor firmware whatever the battery charge, but a motor commanded at
+// its free speed is really running at full voltage, and its speed drops with
+// the battery. Timed segments that run a motor flat out are stretched by the
+// compensation factor so they cover the same distance on a drained battery as
+// on the battery autonomous was tuned with.
+
+// Battery voltage the autonomous routines were tuned at
+const double NOMINAL_BATTERY_VOLTAGE = 12.6; // V
+
+// Filtered battery voltage in volts, as last sampled by the power manager.
+// Nominal until the power manager has a reading.
+double battery_voltage();
+
+// Nominal voltage over current voltage, limited to a sane range
+double battery_compensation();
+
+// Scales a time for a segment where a motor runs at its free speed
+std::uint32_t compensated_time(std::uint32_t milliseconds);
+void compensated_delay(std::uint32_t milliseconds);
+
+#endif // _POWER_HPP_
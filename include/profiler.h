@@ -0,0 +1,63 @@
+#ifndef _PROFILER_HPP_
+#define _PROFILER_HPP_
+
+#include "api.h"
+#include <atomic>
+
+// Replaces the millis()/delay_until pair at the top and bottom of a periodic
+// task loop, and records how long each cycle was busy and how late each
+// wake-up was compared to its deadline. Every ProfiledLoop registers itself so
+// the profiler task can report all of them, and is never unregistered, so it
+// has to live as long as the program.
+//
+// PROS only has a millisecond clock, and loops wake up on a tick, so busy time
+// is counted in whole ticks. It is a lower bound that shows loops which come
+// close to their period, rather than an exact CPU share.
+class ProfiledLoop {
+private:
+	const char *name;
+	std::uint32_t period; // ms
+	std::uint32_t deadline; // ms
+
+	// Totals since the loop started, read by the profiler task
+	std::atomic<std::uint32_t> cycles;
+	std::atomic<std::uint32_t> busy_time; // ms
+	std::atomic<std::uint32_t> lateness; // ms
+	std::atomic<std::uint32_t> overruns;
+	std::atomic<std::uint32_t> max_lateness; // ms, since the last report
+	std::atomic<bool> reset_max;
+
+	friend void profiler_task_fn(void *param);
+
+public:
+	ProfiledLoop(const char *name, std::uint32_t period);
+
+	// Waits until the start of the next cycle
+	void wait();
+
+	// Starts the schedule again from now, for a loop in a task that was
+	// deleted and recreated
+	void restart();
+};
+
+// Per loop statistics over the last report window
+struct LoopProfile {
+	const char *name;
+	double load; // fraction of the window the loop was busy
+	double mean_lateness; // ms
+	std::uint32_t max_lateness; // ms
+	std::uint32_t overruns; // cycles that took longer than the period
+};
+
+const int PROFILER_MAX_LOOPS = 16;
+
+// Starts a low priority task that summarises every loop once a second and
+// prints it to the terminal
+void profiler_start();
+
+// Total load of all profiled loops, and the worst wake-up lateness of any of
+// them, over the last report window
+double profiler_load();
+std::uint32_t profiler_worst_lateness();
+
+#endif // _PROFILER_HPP_
@@ -2,24 +2,51 @@
 #define _ROBOT_HPP_
 
 #include "api.h"
+#include "units.h"
+#include <vector>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// How long block() waits for a command that doesn't know how long it should
+// take
+const std::uint32_t BLOCK_DEADLINE = 5000; // ms
+
 class BlockCommand {
 public:
+	// Commands that can tell how long they should take set this from
+	// command_deadline()
+	std::uint32_t deadline = BLOCK_DEADLINE; // ms
+
 	virtual bool check() = 0;
+
+	// Waits until the command finishes or misses its deadline, which trips the
+	// supervisor's safe state. Returns at once while the safe state is from a
+	// missed deadline, or once the calling task's commands are cancelled.
 	void block();
 };
 
+// Makes every block() in the given task return at once, so a routine running
+// on it can be stopped without deleting the task while it holds a mutex. NULL
+// cancels nothing.
+void cancel_commands(pros::task_t task);
+
+// Whether the calling task's commands have been cancelled. Routines with steps
+// that don't block check this between them.
+bool commands_cancelled();
+
+// Deadline for a command expected to take the given time, with room for a
+// drained battery or a heavy load
+std::uint32_t command_deadline(double expected_time); // ms
+
 class MotorBlockCommand;
 class MultiBlockCommand;
 
 class MotorSystem {
 public:
-	// Velocity in RPM
-	virtual void move_velocity(double velocity) = 0;
+	// Velocity of the motor shafts
+	virtual void move_velocity(okapi::QAngularSpeed velocity) = 0;
 
 	// Optional
 	virtual void recenter() {};
@@ -27,16 +54,27 @@ public:
 
 class AngularMotorSystem: public MotorSystem {
 public:
-	// Angle should be in rotations
-	virtual BlockCommand *move_angle(double angle) = 0;
-	virtual void set_speed(double speed) = 0;
+	// Angle of the mechanism, after any gear ratio
+	virtual BlockCommand *move_angle(okapi::QAngle angle) = 0;
+	virtual void set_speed(okapi::QAngularSpeed speed) = 0;
 };
 
 class LinearMotorSystem: public MotorSystem {
 public:
-	// Distance should be in inches
-	virtual BlockCommand *move_distance(double distance) = 0;
-	virtual void set_speed(double speed) = 0;
+	virtual BlockCommand *move_distance(okapi::QLength distance) = 0;
+	virtual void set_speed(okapi::QAngularSpeed speed) = 0;
+
+	// Distance travelled since the motors were last zeroed
+	virtual okapi::QLength get_distance() = 0;
+
+	// Free speed of the motors
+	virtual okapi::QAngularSpeed get_max_velocity() = 0;
+
+	// Surface velocities. The measured velocity comes from the motor encoders,
+	// and the max velocity is the surface speed at the motors' free speed.
+	virtual okapi::QSpeed get_linear_velocity() = 0;
+	virtual okapi::QSpeed get_max_linear_velocity() = 0;
+	virtual void move_linear_velocity(okapi::QSpeed velocity) = 0;
 };
 
 // In future, add an AbsoluteAngularMotorSystem interface with a move_to_angle
@@ -46,16 +84,22 @@ public:
 
 class AbsoluteAngularMotorSystem: public AngularMotorSystem {
 public:
-	virtual BlockCommand *move_to_angle(double angle) = 0;
+	virtual BlockCommand *move_to_angle(okapi::QAngle angle) = 0;
+
+	// Current angle of the mechanism, measured from where the motors were zeroed
+	virtual okapi::QAngle get_angle() = 0;
 };
 
 // Implementation classes:
-class WheelMotorSystem;
-class TurnDriveMotorSystem;
-class StraightDriveMotorSystem;
-class RollerMotorSystem;
 class TrayMotorSystem;
 class ArmMotorSystem;
+class IntakeMonitor;
+struct RobotTelemetry;
+class PowerManager;
+class HeadingEstimator;
+class TargetTracker;
+class DistanceSensor;
+class Simulator;
 
 class RobotDeviceInterfaces {
 private:
@@ -73,15 +117,38 @@ public:
 	LinearMotorSystem *roller;
 	LinearMotorSystem *stack_setdown;
 
+	IntakeMonitor *intake;
+	PowerManager *power;
+	HeadingEstimator *heading;
+	TargetTracker *vision; // NULL if there is no vision sensor
+	DistanceSensor *wall; // NULL if there is no ultrasonic
+
 	pros::Controller *controller;
 
     RobotDeviceInterfaces();
+	// The same systems built on the simulator's motors and sensors
+	RobotDeviceInterfaces(Simulator *simulator);
 
 	void activate_brakes();
 	void deactivate_brakes();
+
+	void sample_telemetry(RobotTelemetry *sample);
+
+	// Motors that hold the arm and tray with their firmware position loops
+	std::vector<pros::Motor*> get_arm_motors();
+	std::vector<pros::Motor*> get_tray_motors();
+
+	// Every motor, in TelemetryMotor order
+	std::vector<pros::Motor*> get_motors();
 };
 
+// Returns a command that finishes as soon as either command finishes
+BlockCommand *either(BlockCommand *c1, BlockCommand *c2);
+// Returns a command that finishes once both commands have finished
+BlockCommand *both(BlockCommand *c1, BlockCommand *c2);
+
 void unfold(RobotDeviceInterfaces*);
+void setdown(RobotDeviceInterfaces*);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,121 @@
+#ifndef _ROBOT_CONFIG_HPP_
+#define _ROBOT_CONFIG_HPP_
+
+#include "api.h"
+#include "units.h"
+#include <cstdint>
+
+// The physical description of the robot lives in this one table. Everything
+// that depends on wiring or mechanical build (ports, cartridges, reversal,
+// wheel sizes and gear ratios) is read from here when the RobotDeviceInterfaces
+// are built, and the table is checked at compile time.
+
+struct MotorConfig {
+	std::uint8_t port;
+	pros::motor_gearset_e_t gearset;
+	bool reversed;
+};
+
+// Three wire (ADI) sensors are on ports 1-8, or 0 if the sensor isn't fitted
+struct SensorConfig {
+	std::uint8_t port;
+	bool reversed;
+};
+
+struct RobotConfig {
+	MotorConfig left_drive, right_drive;
+	MotorConfig left_arm, right_arm;
+	MotorConfig tray;
+	MotorConfig left_roller, right_roller;
+
+	SensorConfig gyro;
+	std::uint8_t vision_port; // Smart port, or 0 if there is no vision sensor
+	std::uint8_t ultrasonic_echo, ultrasonic_ping; // Three wire ports, or 0
+
+	okapi::QLength wheel_diameter;
+	okapi::QLength inter_wheel_distance;
+	okapi::QLength roller_radius;
+};
+
+constexpr RobotConfig ROBOT_CONFIG = {
+	{11, MOTOR_GEARSET_18, false}, // left_drive
+	{20, MOTOR_GEARSET_18, true},  // right_drive
+	{3, MOTOR_GEARSET_36, false},  // left_arm
+	{10, MOTOR_GEARSET_36, true},  // right_arm
+	{19, MOTOR_GEARSET_36, true},  // tray
+	{2, MOTOR_GEARSET_36, true},   // left_roller
+	{9, MOTOR_GEARSET_36, false},  // right_roller
+
+	{1, false}, // gyro
+	8,          // vision_port
+	3, 4,       // ultrasonic_echo, ultrasonic_ping
+
+	3.25 * okapi::inch,   // wheel_diameter
+	10.125 * okapi::inch, // inter_wheel_distance
+	1.5 * okapi::inch,    // roller_radius
+};
+
+// Gear trains are types rather than table entries so their conversions are
+// folded at compile time.
+typedef GearRatio<std::ratio<7>> TrayGearRatio;
+typedef GearRatio<std::ratio<7>> ArmGearRatio;
+
+constexpr bool valid_port(const MotorConfig &motor) {
+	return motor.port >= 1 && motor.port <= 21;
+}
+
+constexpr bool unique_ports(const RobotConfig &config) {
+	const MotorConfig motors[] = {
+		config.left_drive, config.right_drive,
+		config.left_arm, config.right_arm,
+		config.tray,
+		config.left_roller, config.right_roller,
+	};
+	const int count = sizeof(motors) / sizeof(MotorConfig);
+
+	for(int i = 0; i < count; i++){
+		if(!valid_port(motors[i])){
+			return false;
+		}
+		for(int j = i + 1; j < count; j++){
+			if(motors[i].port == motors[j].port){
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+constexpr bool vision_port_free(const RobotConfig &config) {
+	const MotorConfig motors[] = {
+		config.left_drive, config.right_drive,
+		config.left_arm, config.right_arm,
+		config.tray,
+		config.left_roller, config.right_roller,
+	};
+
+	for(const MotorConfig &motor: motors){
+		if(motor.port == config.vision_port){
+			return false;
+		}
+	}
+	return config.vision_port <= 21;
+}
+
+static_assert(ROBOT_CONFIG.gyro.port <= 8, "Three wire ports are 1 to 8");
+static_assert(ROBOT_CONFIG.ultrasonic_echo == 0
+	|| (ROBOT_CONFIG.ultrasonic_echo % 2 == 1 && ROBOT_CONFIG.ultrasonic_ping == ROBOT_CONFIG.ultrasonic_echo + 1),
+	"The ultrasonic echo goes in an odd three wire port and ping in the next one");
+static_assert(ROBOT_CONFIG.gyro.port == 0
+	|| (ROBOT_CONFIG.gyro.port != ROBOT_CONFIG.ultrasonic_echo && ROBOT_CONFIG.gyro.port != ROBOT_CONFIG.ultrasonic_ping),
+	"The gyro and ultrasonic need their own three wire ports");
+static_assert(unique_ports(ROBOT_CONFIG), "Every motor needs its own port between 1 and 21");
+static_assert(vision_port_free(ROBOT_CONFIG), "The vision sensor needs a port no motor is using");
+static_assert(ROBOT_CONFIG.left_drive.gearset == ROBOT_CONFIG.right_drive.gearset,
+	"Both sides of the drive must use the same cartridge");
+static_assert(ROBOT_CONFIG.left_roller.gearset == ROBOT_CONFIG.right_roller.gearset,
+	"Both rollers must use the same cartridge");
+static_assert(ROBOT_CONFIG.wheel_diameter > okapi::QLength(0.0) && ROBOT_CONFIG.roller_radius > okapi::QLength(0.0),
+	"Wheel sizes must be positive");
+
+#endif // _ROBOT_CONFIG_HPP_
@@ -0,0 +1,80 @@
+#ifndef _SCRIPT_HPP_
+#define _SCRIPT_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include <cstdint>
+#include <vector>
+
+// Autonomous routines can be written as text files on the SD card and compiled
+// to a compact bytecode during initialize(), so a routine can be changed by
+// swapping a file instead of rebuilding and uploading. Each line is one
+// command, and # starts a comment:
+//
+//   drive <inches>           drive straight and wait
+//   turn <rotations>         turn in place, positive is clockwise, and wait
+//   roller <rpm>             spin the rollers, negative intakes
+//   roller_distance <inches> move the roller surface and wait
+//   tray <rotations>         move the tray to an angle and wait
+//   arm <rotations>          move the arm to an angle and wait
+//   speed <system> <rpm>     set the speed of drive, turn, roller, tray or arm
+//   wait <ms>                pause
+//   wait_until cubes <n>     wait until n more cubes are in the intake
+//   parallel ... end         start every command in the block, then wait for
+//                            all of them at end
+//   unfold / setdown         run the unfold and stack setdown macros
+//
+// The waits need a positive number. Any mistake stops the compile with the
+// line number it was found on.
+
+enum ScriptOpcode : std::uint8_t {
+	OP_DRIVE,
+	OP_TURN,
+	OP_ROLLER,
+	OP_ROLLER_DISTANCE,
+	OP_TRAY,
+	OP_ARM,
+	OP_SPEED,
+	OP_WAIT,
+	OP_WAIT_CUBES,
+	OP_PARALLEL,
+	OP_END,
+	OP_UNFOLD,
+	OP_SETDOWN,
+};
+
+// Targets for OP_SPEED
+enum ScriptSystem : std::uint8_t {
+	SYSTEM_DRIVE,
+	SYSTEM_TURN,
+	SYSTEM_ROLLER,
+	SYSTEM_TRAY,
+	SYSTEM_ARM,
+};
+
+struct ScriptInstruction {
+	ScriptOpcode opcode;
+	ScriptSystem system;
+	float argument;
+};
+
+class Script {
+private:
+	std::vector<ScriptInstruction> instructions;
+	bool compiled;
+
+public:
+	Script();
+
+	// Compiles a script file. On an error the line is printed and the script
+	// is left empty, so running it does nothing.
+	bool compile_file(const char *path);
+	bool compile_line(const char *line, int line_number);
+
+	bool is_compiled();
+	int size();
+
+	void run(RobotDeviceInterfaces *robot);
+};
+
+#endif // _SCRIPT_HPP_
@@ -0,0 +1,240 @@
+#ifndef _SIMULATOR_HPP_
+#define _SIMULATOR_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include "okapi/api/control/util/flywheelSimulator.hpp"
+#include <vector>
+
+// A physics model of the robot, for trying out autonomous routines and tuning
+// the controllers without a field. Every mechanism is one degree of freedom
+// built on okapi's FlywheelSimulator:
+//  - each side of the drive is a wheel carrying half the robot's mass, with
+//    the sides coupled by wheel scrub when they turn at different speeds
+//  - the arm swings against gravity
+//  - the tray tips against gravity, carrying the cubes stacked on it
+//  - the rollers take a load while a cube is being pulled in
+// The motors are modelled by SimulatedMotor, which takes the same commands as
+// a pros::Motor. The whole model is stepped at 1kHz on its own task, with
+// every mechanism's input worked out from the same state before any of them
+// advance, so the order they are stepped in doesn't matter.
+
+// One mechanism, with hard stops at either end of its travel. Angles are in
+// radians from horizontal, as FlywheelSimulator uses for gravity.
+class Mechanism: public okapi::FlywheelSimulator {
+private:
+	double min_angle, max_angle;
+
+protected:
+	virtual double stepImpl() override;
+
+public:
+	Mechanism(double mass, double link_length, double min_angle, double max_angle);
+
+	// Puts the mechanism at rest at an angle
+	void reset(double angle);
+};
+
+class Simulator;
+
+enum MotorMode {
+	MOTOR_MODE_VELOCITY,
+	MOTOR_MODE_POSITION,
+	MOTOR_MODE_VOLTAGE,
+};
+
+// A V5 motor driving a mechanism through a gear ratio. Every pros::Motor call
+// is simulated, so none of them reach the port the motor has on the robot.
+// Settings the model doesn't use, like the brake mode and the velocity loop's
+// gains, are kept so they read back as they were set. Positions are only
+// simulated in rotations, the units the robot uses.
+class SimulatedMotor final: public pros::Motor {
+private:
+	Simulator *simulator;
+	Mechanism *mechanism;
+	double ratio; // motor rotations per mechanism rotation
+	mutable pros::motor_gearset_e_t gearset;
+	mutable double free_speed; // rad/s
+	mutable double stall_torque; // N*m
+	mutable bool reversed;
+
+	// The last command. These are written by the robot code and read by the
+	// simulator task, with the simulator locked.
+	mutable MotorMode mode;
+	mutable double target; // RPM, motor rotations or mV
+	mutable double max_velocity; // RPM, for position moves
+	mutable double zero; // mechanism angle where the motor reads 0
+	mutable double current_limit; // mA
+	mutable std::int32_t voltage_limit; // mV
+
+	mutable pros::motor_brake_mode_e_t brake_mode;
+	mutable pros::motor_pid_full_s_t pos_pid, vel_pid;
+
+	double torque; // at the motor, from the last step
+
+	void set_gearset(pros::motor_gearset_e_t gearset) const;
+	double direction() const; // -1 if reversed
+	double position() const; // motor rotations
+	double velocity() const; // RPM
+	double voltage() const; // mV
+
+public:
+	SimulatedMotor(Simulator *simulator, std::uint8_t port, pros::motor_gearset_e_t gearset,
+		Mechanism *mechanism, double ratio);
+
+	// Works out the motor's torque for the next step and returns it as seen
+	// by the mechanism. Called by the simulator.
+	double step_torque();
+
+	std::int32_t operator=(std::int32_t voltage) const override;
+	std::int32_t move(std::int32_t voltage) const override;
+	std::int32_t move_absolute(const double position, const std::int32_t velocity) const override;
+	std::int32_t move_relative(const double position, const std::int32_t velocity) const override;
+	std::int32_t move_velocity(const std::int32_t velocity) const override;
+	std::int32_t move_voltage(const std::int32_t voltage) const override;
+	std::int32_t modify_profiled_velocity(const std::int32_t velocity) const override;
+
+	double get_position(void) const override;
+	double get_target_position(void) const override;
+	double get_actual_velocity(void) const override;
+	std::int32_t get_target_velocity(void) const override;
+	std::int32_t get_current_draw(void) const override;
+	std::int32_t get_direction(void) const override;
+	double get_efficiency(void) const override;
+	std::int32_t is_over_current(void) const override;
+	std::int32_t is_stopped(void) const override;
+	std::int32_t get_zero_position_flag(void) const override;
+	std::uint32_t get_faults(void) const override;
+	std::uint32_t get_flags(void) const override;
+	std::int32_t get_raw_position(std::uint32_t *const timestamp) const override;
+	std::int32_t is_over_temp(void) const override;
+	double get_power(void) const override;
+	double get_temperature(void) const override;
+	double get_torque(void) const override;
+	std::int32_t get_voltage(void) const override;
+
+	std::int32_t set_zero_position(const double position) const override;
+	std::int32_t tare_position(void) const override;
+	std::int32_t set_brake_mode(const pros::motor_brake_mode_e_t mode) const override;
+	std::int32_t set_current_limit(const std::int32_t limit) const override;
+	std::int32_t set_encoder_units(const pros::motor_encoder_units_e_t units) const override;
+	std::int32_t set_gearing(const pros::motor_gearset_e_t gearset) const override;
+	std::int32_t set_pos_pid(const pros::motor_pid_s_t pid) const override;
+	std::int32_t set_pos_pid_full(const pros::motor_pid_full_s_t pid) const override;
+	std::int32_t set_vel_pid(const pros::motor_pid_s_t pid) const override;
+	std::int32_t set_vel_pid_full(const pros::motor_pid_full_s_t pid) const override;
+	std::int32_t set_reversed(const bool reverse) const override;
+	std::int32_t set_voltage_limit(const std::int32_t limit) const override;
+
+	pros::motor_brake_mode_e_t get_brake_mode(void) const override;
+	std::int32_t get_current_limit(void) const override;
+	pros::motor_encoder_units_e_t get_encoder_units(void) const override;
+	pros::motor_gearset_e_t get_gearing(void) const override;
+	pros::motor_pid_full_s_t get_pos_pid(void) const override;
+	pros::motor_pid_full_s_t get_vel_pid(void) const override;
+	std::int32_t is_reversed(void) const override;
+	std::int32_t get_voltage_limit(void) const override;
+};
+
+enum SimulatedMotorId {
+	SIM_LEFT_DRIVE,
+	SIM_RIGHT_DRIVE,
+	SIM_LEFT_ARM,
+	SIM_RIGHT_ARM,
+	SIM_TRAY,
+	SIM_LEFT_ROLLER,
+	SIM_RIGHT_ROLLER,
+	SIM_MOTOR_COUNT,
+};
+
+// Where the robot is on the field. The origin is a corner of the field, and
+// heading is clockwise from the x axis, matching the sign of turn_drive.
+struct SimulatedPose {
+	okapi::QLength x, y;
+	okapi::QAngle heading;
+};
+
+class Simulator {
+private:
+	pros::Mutex mutex;
+	pros::Task *task;
+
+	Mechanism left_wheel, right_wheel;
+	Mechanism arm, tray, rollers;
+	SimulatedMotor *motors[SIM_MOTOR_COUNT];
+
+	// Robot pose, in metres and radians
+	double x, y, heading;
+	double start_x, start_y, start_heading;
+
+	// Cubes in a line ahead of where the robot started, as distances along its
+	// starting heading
+	std::vector<double> cubes; // m
+	int next_cube;
+	bool cube_in_contact;
+	double contact_roller_angle; // rad, where the rollers first touched the cube
+	int stacked_cubes;
+
+	static void task_fn(void *param);
+	void step();
+	void step_pose();
+	double step_cube_load();
+
+public:
+	Simulator();
+
+	// Starts stepping the model. Called by the robot built on it.
+	void start();
+
+	// Held while the model steps, and by the motors while they take a command
+	void lock();
+	void unlock();
+
+	SimulatedMotor *get_motor(SimulatedMotorId id);
+
+	// Puts the robot back at the given pose with every mechanism at rest,
+	// and clears the cubes
+	void reset(SimulatedPose pose);
+
+	// Lines up cubes ahead of the robot, starting at first and spacing apart
+	void place_cubes(okapi::QLength first, okapi::QLength spacing, int count);
+
+	SimulatedPose get_pose();
+
+	// Distance from the front of the robot to the field wall straight ahead
+	okapi::QLength get_wall_distance();
+
+	// Cubes pulled into the robot so far
+	int get_stacked_cubes();
+};
+
+// The simulator is made the first time it is asked for
+Simulator *get_simulator();
+
+// A simulated motor called through a static interface like PortMotor, so the
+// motor templates can be built on the simulator
+template<SimulatedMotorId Id>
+class SimulatorPort {
+public:
+	static void move_velocity(double velocity){
+		get_simulator()->get_motor(Id)->move_velocity(velocity);
+	}
+
+	static void move_relative(double position, double velocity){
+		get_simulator()->get_motor(Id)->move_relative(position, velocity);
+	}
+
+	static double get_position(){
+		return get_simulator()->get_motor(Id)->get_position();
+	}
+
+	static double get_actual_velocity(){
+		return get_simulator()->get_motor(Id)->get_actual_velocity();
+	}
+
+	static pros::motor_gearset_e_t get_gearing(){
+		return get_simulator()->get_motor(Id)->get_gearing();
+	}
+};
+
+#endif // _SIMULATOR_HPP_
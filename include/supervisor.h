@@ -0,0 +1,65 @@
+#ifndef _SUPERVISOR_HPP_
+#define _SUPERVISOR_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include <atomic>
+
+// The supervisor is a high priority task that watches for the ways the robot
+// can get stuck and puts it in a safe state, where the power manager gives
+// every motor a current limit of zero, so nothing moves whatever it is told.
+//
+// - Every BlockCommand has a deadline, sized from how long it should take
+//   where the command can tell. A command that misses it stops waiting and
+//   trips the safe state, and later commands return at once, so a hung
+//   routine costs its deadline rather than the rest of the match. The safe
+//   state from a missed deadline is released when a driver macro ends or the
+//   competition mode changes.
+// - Control tasks beat a Heartbeat every cycle. A critical heartbeat that
+//   stops trips the safe state until it beats again, and any other one is
+//   only logged.
+// - Motor h-bridge faults trip the safe state until every motor has been
+//   clear of them for a second. Lost contact with a motor and over
+//   temperature are only logged, since the power manager already derates hot
+//   motors, and over current is normal whenever a limit is reached.
+
+enum SafeReason {
+	SAFE_DEADLINE = 1,
+	SAFE_HEARTBEAT = 2,
+	SAFE_FAULT = 4,
+};
+
+class Heartbeat {
+private:
+	const char *name;
+	std::uint32_t timeout; // ms
+	bool critical;
+	// Time of the last beat, or 0 if it hasn't beaten since the competition
+	// mode changed. A task that isn't running in this mode isn't watched.
+	std::atomic<std::uint32_t> last_beat;
+	bool missed;
+
+	friend void supervisor_task_fn(void *param);
+
+public:
+	// Registers with the supervisor, so it has to live as long as the program
+	Heartbeat(const char *name, std::uint32_t timeout, bool critical);
+
+	void beat();
+};
+
+const int SUPERVISOR_MAX_HEARTBEATS = 8;
+
+// Starts watching the robot's motors and the registered heartbeats
+void supervisor_start(RobotDeviceInterfaces *robot);
+
+// Called by BlockCommand::block when a command misses its deadline
+void supervisor_deadline_missed();
+
+// Releases the safe state for the given reasons
+void supervisor_release(int reasons);
+
+// Why the robot is in the safe state, as SafeReason bits, or 0 if it isn't
+int supervisor_safe_reasons();
+
+#endif // _SUPERVISOR_HPP_
@@ -0,0 +1,37 @@
+#ifndef _TELEMETRY_HPP_
+#define _TELEMETRY_HPP_
+
+#include "api.h"
+#include "robot.h"
+
+// Indexes into RobotTelemetry::motor_temperatures
+enum TelemetryMotor {
+	TELEMETRY_LEFT_DRIVE,
+	TELEMETRY_RIGHT_DRIVE,
+	TELEMETRY_LEFT_ARM,
+	TELEMETRY_RIGHT_ARM,
+	TELEMETRY_TRAY,
+	TELEMETRY_LEFT_ROLLER,
+	TELEMETRY_RIGHT_ROLLER,
+	TELEMETRY_MOTOR_COUNT,
+};
+
+extern const char *TELEMETRY_MOTOR_NAMES[TELEMETRY_MOTOR_COUNT];
+
+// One sample of the robot state shown on the dashboard. Values are raw motor
+// units so that sampling stays cheap.
+struct RobotTelemetry {
+	std::uint32_t time; // ms
+	double left_drive_velocity, right_drive_velocity; // RPM
+	double arm_skew; // motor rotations between the left and right arm motors
+	double tray_angle; // tray rotations
+	double motor_temperatures[TELEMETRY_MOTOR_COUNT]; // Celsius
+	double control_load; // fraction of the CPU used by the profiled loops
+	std::uint32_t worst_lateness; // ms
+};
+
+// Starts sampling the robot in a low priority task and shows the dashboard on
+// the brain screen. Calling this again just brings the dashboard to the front.
+void telemetry_start(RobotDeviceInterfaces *robot);
+
+#endif // _TELEMETRY_HPP_
@@ -0,0 +1,40 @@
+#ifndef _UI_TASK_HPP_
+#define _UI_TASK_HPP_
+
+#include "api.h"
+#include "handoff.h"
+
+// Printing to the terminal, the controller status lines and SD card writes
+// can all take milliseconds, so the tasks that move the robot hand them to
+// one low priority UI task instead of doing them in place. Every task that
+// hands work over has its own UiQueue, so posting never waits on the UI task
+// or on another task. Anything posted to a full queue is dropped.
+
+const int UI_MESSAGE_LENGTH = 64;
+const int UI_MAX_QUEUES = 8;
+const int UI_MAX_REFRESHES = 4;
+
+struct UiItem {
+	void (*work)(); // NULL for a message
+	char message[UI_MESSAGE_LENGTH];
+};
+
+typedef SpscQueue<UiItem, 16> UiQueue;
+
+// Returns a new queue for the calling task. Each task should get one once and
+// keep it, and no other task may post to it.
+UiQueue *ui_queue();
+
+// Formats a message to be printed to the terminal, with a newline added
+void ui_printf(UiQueue *queue, const char *format, ...);
+
+// Runs work on the UI task
+void ui_defer(UiQueue *queue, void (*work)());
+
+// Adds a function that the UI task calls every cycle, after printing
+void ui_add_refresh(void (*refresh)());
+
+// Starts the UI task. Work can be posted before it starts.
+void ui_task_start();
+
+#endif // _UI_TASK_HPP_
@@ -0,0 +1,67 @@
+#ifndef _UNITS_HPP_
+#define _UNITS_HPP_
+
+#include "okapi/api/units/QAngle.hpp"
+#include "okapi/api/units/QAngularSpeed.hpp"
+#include "okapi/api/units/QLength.hpp"
+#include "okapi/api/units/QSpeed.hpp"
+#include "okapi/api/units/QTime.hpp"
+#include <ratio>
+
+// The motor systems are typed on okapi's compile-time units so that passing a
+// distance where an angle is expected, or forgetting a gear ratio, is a compile
+// error. Raw doubles only appear at the pros::Motor boundary, which works in
+// motor rotations and RPM.
+
+// The V5 motors count their encoders in rotations
+constexpr okapi::QAngle rotation = 360 * okapi::degree;
+
+constexpr okapi::QAngle operator"" _rot(long double x) {
+	return static_cast<double>(x) * rotation;
+}
+constexpr okapi::QAngle operator"" _rot(unsigned long long int x) {
+	return static_cast<double>(x) * rotation;
+}
+
+// Conversions to the raw values the pros::Motor API takes
+constexpr double to_rotations(okapi::QAngle angle) {
+	return angle.convert(rotation);
+}
+constexpr double to_rpm(okapi::QAngularSpeed speed) {
+	return speed.convert(okapi::rpm);
+}
+
+// A gear train between a motor and the mechanism it drives, with the ratio as a
+// std::ratio so that conversions fold into constants. Ratio is motor turns per
+// mechanism turn.
+template <typename Ratio>
+class GearRatio {
+public:
+	static constexpr double ratio = static_cast<double>(Ratio::num) / Ratio::den;
+
+	// Motor rotations needed to turn the mechanism by an angle
+	static constexpr double motor_rotations(okapi::QAngle angle) {
+		return to_rotations(angle) * ratio;
+	}
+
+	// Mechanism angle for a motor position in rotations
+	static constexpr okapi::QAngle mechanism_angle(double motor_rotations) {
+		return motor_rotations / ratio * rotation;
+	}
+};
+
+// Conversions between a wheel's angle and the distance its surface moves
+constexpr okapi::QLength arc_length(okapi::QAngle angle, okapi::QLength diameter) {
+	return angle.convert(okapi::radian) * diameter / 2;
+}
+constexpr okapi::QAngle wheel_angle(okapi::QLength distance, okapi::QLength diameter) {
+	return (distance / (diameter / 2)).getValue() * okapi::radian;
+}
+constexpr okapi::QSpeed surface_speed(okapi::QAngularSpeed speed, okapi::QLength diameter) {
+	return speed.convert(okapi::radps) * diameter / 2 / okapi::second;
+}
+constexpr okapi::QAngularSpeed wheel_speed(okapi::QSpeed speed, okapi::QLength diameter) {
+	return (speed * okapi::second / (diameter / 2)).getValue() * okapi::radps;
+}
+
+#endif // _UNITS_HPP_
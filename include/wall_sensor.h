@@ -0,0 +1,48 @@
+#ifndef _WALL_SENSOR_HPP_
+#define _WALL_SENSOR_HPP_
+
+#include "api.h"
+#include "robot.h"
+#include <functional>
+
+// Measures the distance from the front of the robot to the wall or goal ahead
+class DistanceSensor {
+public:
+	// Returns 0 when nothing is in range
+	virtual okapi::QLength get_distance() = 0;
+};
+
+class UltrasonicDistanceSensor final: public DistanceSensor {
+private:
+	pros::ADIUltrasonic ultrasonic;
+
+public:
+	UltrasonicDistanceSensor(std::uint8_t ping_port, std::uint8_t echo_port);
+
+	okapi::QLength get_distance() override;
+};
+
+// Stands in for the ultrasonic when there isn't one, such as in the simulator.
+// It reads a true distance and adds the sensor's centimetre resolution and the
+// occasional missed echo.
+class SimulatedUltrasonic final: public DistanceSensor {
+private:
+	std::function<okapi::QLength()> truth;
+	int dropout_period; // readings
+	int readings;
+
+public:
+	SimulatedUltrasonic(std::function<okapi::QLength()> truth, int dropout_period = 7);
+
+	okapi::QLength get_distance() override;
+};
+
+// Drives straight until the wall ahead is standoff away, slowing down as it
+// gets close so it can start at full speed. Missed echoes are skipped and the
+// rest are median filtered to throw out stray ones. If the robot has no sensor,
+// or it never gets a reading, it drives the fallback distance open loop
+// instead. The approach stops early if it travels well past the fallback
+// distance or runs out of time.
+BlockCommand *approach_wall(RobotDeviceInterfaces *robot, okapi::QLength standoff, okapi::QLength fallback);
+
+#endif // _WALL_SENSOR_HPP_
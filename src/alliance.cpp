@@ -0,0 +1,90 @@
+#include "main.h"
+#include "alliance.h"
+#include <map>
+#include <utility>
+
+const AllianceCalibration ALLIANCE_CALIBRATION[ALLIANCE_COUNT] = {
+	// Red is the side the routines are written for
+	{0 * rotation, 0 * okapi::inch, 3 * okapi::inch},
+	// Blue big side turns fall about 0.005 rotations short and the small goal
+	// sits half an inch further out
+	{0.005 * rotation, 0.5 * okapi::inch, 4 * okapi::inch},
+};
+
+class AllianceTurnSystem final: public AngularMotorSystem {
+private:
+	AngularMotorSystem *turn;
+	double direction;
+
+public:
+	virtual void move_velocity(okapi::QAngularSpeed velocity) override {
+		this->turn->move_velocity(this->direction * velocity);
+	}
+
+	virtual void recenter() override {
+		this->turn->recenter();
+	}
+
+	virtual BlockCommand *move_angle(okapi::QAngle angle) override {
+		return this->turn->move_angle(this->direction * angle);
+	}
+
+	virtual void set_speed(okapi::QAngularSpeed speed) override {
+		this->turn->set_speed(speed);
+	}
+
+	AllianceTurnSystem(AngularMotorSystem *turn, Alliance alliance){
+		this->turn = turn;
+		this->direction = alliance == ALLIANCE_BLUE ? -1 : 1;
+	}
+};
+
+// The field is mirrored, and so are the cubes on it
+class AllianceTargetTracker final: public TargetTracker {
+private:
+	TargetTracker *tracker;
+	double direction;
+
+public:
+	virtual bool get_bearing(okapi::QAngle *bearing) override {
+		bool valid = this->tracker->get_bearing(bearing);
+		*bearing = this->direction * *bearing;
+		return valid;
+	}
+
+	AllianceTargetTracker(TargetTracker *tracker, Alliance alliance){
+		this->tracker = tracker;
+		this->direction = alliance == ALLIANCE_BLUE ? -1 : 1;
+	}
+};
+
+RobotDeviceInterfaces alliance_robot(RobotDeviceInterfaces *robot, Alliance alliance){
+	// One adapter per alliance for each system mirrored, made the first time
+	// it is asked for. The turn system differs between the drive backends and
+	// the simulator, so more than one can be wrapped.
+	static std::map<std::pair<AngularMotorSystem*, Alliance>, AllianceTurnSystem*> turns;
+	static std::map<std::pair<TargetTracker*, Alliance>, AllianceTargetTracker*> trackers;
+
+	RobotDeviceInterfaces mirrored = *robot;
+
+	auto turn = turns.find({robot->turn_drive, alliance});
+	if(turn == turns.end()){
+		turn = turns.insert({{robot->turn_drive, alliance},
+			new AllianceTurnSystem(robot->turn_drive, alliance)}).first;
+	}
+	mirrored.turn_drive = turn->second;
+
+	if(robot->vision != NULL){
+		auto tracker = trackers.find({robot->vision, alliance});
+		if(tracker == trackers.end()){
+			tracker = trackers.insert({{robot->vision, alliance},
+				new AllianceTargetTracker(robot->vision, alliance)}).first;
+		}
+		mirrored.vision = tracker->second;
+	}
+	if(alliance == ALLIANCE_BLUE){
+		mirrored.left_drive = robot->right_drive;
+		mirrored.right_drive = robot->left_drive;
+	}
+	return mirrored;
+}
@@ -1,65 +1,93 @@
 #include "main.h"
+#include "alliance.h"
+#include "benchmark.h"
+#include "calibration.h"
+#include "display/lvgl.h"
+#include "okapi_drive.h"
+#include "pid_tuning.h"
+#include "script.h"
+#include "simulator.h"
+#include "ui_task.h"
 #include <tuple>
 #include <vector>
 
-// https://stackoverflow.com/a/1082938
-int eucmod(int x, int m){
-    return (x%m + m)%m;
-}
-
 void setdown(RobotDeviceInterfaces *robot){
-    robot->roller->set_speed(50);
-    robot->roller->move_distance(5.5)->block();
-    robot->roller->move_distance(-1.5)->block();
+    robot->roller->set_speed(50_rpm);
+    robot->roller->move_distance(5.5_in)->block();
+    robot->roller->move_distance(-1.5_in)->block();
     pros::delay(250);
 
-    robot->tray->move_angle(0.23)->block();
+    robot->tray->move_angle(0.23_rot)->block();
 
-    robot->roller->move_distance(1)->block();
+    robot->roller->move_distance(1_in)->block();
     pros::delay(250);
 
-    robot->stack_setdown->set_speed(50);
-    robot->stack_setdown->move_distance(12)->block();
-    robot->stack_setdown->set_speed(100);
+    // The rollers track the drive, so back out as fast as they can keep up
+    robot->stack_setdown->set_speed(robot->stack_setdown->get_max_velocity());
+    robot->stack_setdown->move_distance(12_in)->block();
+    robot->stack_setdown->set_speed(100_rpm);
+}
+
+// Distance from the ultrasonic to the wall when a stack is set down in the
+// small goal zone. It hasn't been measured on the field yet, and until it is
+// this stays 0 and the routines drive their tuned distances open loop.
+const okapi::QLength GOAL_STANDOFF = 0_in;
+
+// Which drive backend the autonomous routines run on
+const DriveBackend AUTONOMOUS_DRIVE_BACKEND = DRIVE_BACKEND_NATIVE;
+
+// The routines below are written for the red side. run_for_alliance mirrors
+// them for blue and passes in that side's calibration.
+typedef void (*AllianceRoutine)(RobotDeviceInterfaces*, const AllianceCalibration&);
+
+void run_for_alliance(AllianceRoutine routine, RobotDeviceInterfaces *robot, Alliance alliance){
+    RobotDeviceInterfaces side = alliance_robot(robot, alliance);
+    routine(&side, ALLIANCE_CALIBRATION[alliance]);
 }
 
-void four_point_autonomous(RobotDeviceInterfaces *robot, bool is_reversed){
+void four_point_autonomous(RobotDeviceInterfaces *robot, const AllianceCalibration &calibration){
     unfold(robot);
 
-    robot->roller->move_velocity(-100);
+    robot->roller->move_velocity(-100_rpm);
 
-    double d = 36; // Distance to drive forward to pick up first stack
+    okapi::QLength d = 36_in; // Furthest distance to drive forward to pick up first stack
+    const int cubes = 4; // Number of cubes in the first stack
 
-    // Drive forward at 55RPM
-    robot->straight_drive->set_speed(60);
-    robot->straight_drive->move_distance(d)->block();
+    // Drive forward at 60RPM, steering onto the stack if the vision sensor can
+    // see it, until the last cube is in. Then stop right away instead of
+    // finishing the full distance.
+    robot->intake->reset_cube_count();
+    okapi::QLength start = robot->straight_drive->get_distance();
+    either(
+        drive_to_cube(robot, d, 60_rpm),
+        robot->intake->wait_for_cubes(cubes)
+    )->block();
+    robot->straight_drive->move_velocity(0_rpm);
+    okapi::QLength travelled = robot->straight_drive->get_distance() - start;
 
     // Drive back at 100RPM and keep the block command for later
-    robot->straight_drive->set_speed(100);
-    auto drive_back = robot->straight_drive->move_distance(-d + 15);
+    robot->straight_drive->set_speed(100_rpm);
+    auto drive_back = robot->straight_drive->move_distance(-travelled + 15_in);
 
     // Wait half a bit then stop the rollers.
-    pros::delay(100);
-    robot->roller->move_velocity(0);
+    compensated_delay(100);
+    robot->roller->move_velocity(0_rpm);
 
-    robot->roller->set_speed(50);
-    if(is_reversed){
-        robot->roller->move_distance(4)->block();
-        robot->roller->move_distance(-4)->block();
-    } else {
-        robot->roller->move_distance(3)->block();
-        robot->roller->move_distance(-3)->block();
-    }
+    robot->roller->set_speed(50_rpm);
+    robot->roller->move_distance(calibration.roller_reseat)->block();
+    robot->roller->move_distance(-1 * calibration.roller_reseat)->block();
 
     // Wait unitl the drive backward is done.
     drive_back->block();
 
-    if(is_reversed){
-        robot->turn_drive->move_angle(-0.38)->block();
-        robot->straight_drive->move_distance(7.25)->block();
+    // Close in on the goal zone wall, or drive the tuned distance if the
+    // ultrasonic can't see it or the standoff hasn't been measured
+    robot->turn_drive->move_angle(0.38_rot)->block();
+    okapi::QLength approach = 6.75_in + calibration.approach_offset;
+    if(GOAL_STANDOFF > 0_in){
+        approach_wall(robot, GOAL_STANDOFF, approach)->block();
     } else {
-        robot->turn_drive->move_angle(0.38)->block();
-        robot->straight_drive->move_distance(6.75)->block();
+        robot->straight_drive->move_distance(approach)->block();
     }
 
     setdown(robot);
@@ -67,40 +95,68 @@ void four_point_autonomous(RobotDeviceInterfaces *robot, bool is_reversed){
     // TODO: Put the tray back into the neutral position
 }
 
-void big_side_autonomous(RobotDeviceInterfaces *robot, bool is_reversed){
+void big_side_autonomous(RobotDeviceInterfaces *robot, const AllianceCalibration &calibration){
     // Drive forward then backward to push a cube into the goal zone.
     unfold(robot);
 
-    robot->straight_drive->move_distance(24)->block();
+    robot->straight_drive->move_distance(24_in)->block();
 
-    if(is_reversed){
-        robot->turn_drive->move_angle(-0.08)->block();
-    } else {
-        robot->turn_drive->move_angle(0.075)->block();
-    }
+    robot->turn_drive->move_angle(0.075_rot + calibration.turn_bias)->block();
 
-    robot->roller->move_velocity(-100);
-    robot->straight_drive->set_speed(200);
-    robot->straight_drive->move_distance(-2);
-    robot->straight_drive->move_distance(20)->block();
-    robot->roller->move_velocity(0);
+    robot->roller->move_velocity(-100_rpm);
+    robot->straight_drive->set_speed(200_rpm);
+    robot->straight_drive->move_distance(-2_in);
+    robot->straight_drive->move_distance(20_in)->block();
+    robot->roller->move_velocity(0_rpm);
     pros::delay(250);
 
-    robot->turn_drive->set_speed(75);
-    if(is_reversed){
-        robot->turn_drive->move_angle(0.465)->block();
-    } else {
-        robot->turn_drive->move_angle(-0.46)->block();
-    }
+    robot->turn_drive->set_speed(75_rpm);
+    robot->turn_drive->move_angle(-0.46_rot - calibration.turn_bias)->block();
 
-    robot->straight_drive->set_speed(100);
-    robot->roller->move_velocity(-100);
-    robot->straight_drive->move_distance(35)->block();
-    robot->roller->move_velocity(0);
+    robot->straight_drive->set_speed(100_rpm);
+    robot->roller->move_velocity(-100_rpm);
+    robot->straight_drive->move_distance(35_in)->block();
+    robot->roller->move_velocity(0_rpm);
 
     setdown(robot);
 }
 
+// The simulated field. The red small goal zone is in the corner clockwise from
+// where the robot starts, and the first stack is lined up straight ahead.
+const SimulatedPose SIMULATED_START = {18_in, 120_in, 0_deg};
+const okapi::QLength SIMULATED_FIRST_CUBE = 12_in;
+const okapi::QLength SIMULATED_CUBE_SPACING = 5.5_in;
+
+// The robot built on the simulator, made the first time it is used
+RobotDeviceInterfaces *simulated_robot(){
+    static RobotDeviceInterfaces simulated(get_simulator());
+    return &simulated;
+}
+
+// Runs a red routine on the simulator and prints where the robot ended up
+void run_simulated(AllianceRoutine routine){
+    Simulator *simulator = get_simulator();
+    simulator->reset(SIMULATED_START);
+    simulator->place_cubes(SIMULATED_FIRST_CUBE, SIMULATED_CUBE_SPACING, 4);
+
+    std::uint32_t start = pros::millis();
+    run_for_alliance(routine, simulated_robot(), ALLIANCE_RED);
+
+    SimulatedPose pose = simulator->get_pose();
+    printf("Simulated routine took %u ms, stacked %d cubes, finished at (%.1f in, %.1f in, %.1f deg)\n",
+        (unsigned int)(pros::millis() - start), simulator->get_stacked_cubes(),
+        pose.x.convert(okapi::inch), pose.y.convert(okapi::inch), pose.heading.convert(okapi::degree));
+}
+
+// A routine written on the SD card, compiled once in initialize() so nothing
+// is parsed when the match starts
+const char *AUTONOMOUS_SCRIPT_FILE = "/usd/routine.txt";
+Script autonomous_script;
+
+void load_autonomous_script(){
+    autonomous_script.compile_file(AUTONOMOUS_SCRIPT_FILE);
+}
+
 const int default_autonomous_selection = 5;
 
 int autonomous_selection;
@@ -108,77 +164,219 @@ std::vector<std::tuple<std::string, void (*)(RobotDeviceInterfaces*)>> autonomou
     {"None", [](RobotDeviceInterfaces* robot){}},
     {"ol' reliable", [](RobotDeviceInterfaces *robot){
         // Drive forward then backward to push a cube into the goal zone.
-        robot->straight_drive->move_distance(12)->block();
-        robot->straight_drive->move_distance(-12)->block();
+        robot->straight_drive->move_distance(12_in)->block();
+        robot->straight_drive->move_distance(-12_in)->block();
 
         unfold(robot);
     }},
     {"red small autonomous", [](RobotDeviceInterfaces *robot){
-        four_point_autonomous(robot, false);
+        run_for_alliance(four_point_autonomous, robot, ALLIANCE_RED);
     }},
     {"blue small autonomous", [](RobotDeviceInterfaces *robot){
-        four_point_autonomous(robot, true);
+        run_for_alliance(four_point_autonomous, robot, ALLIANCE_BLUE);
     }},
     {"red big autonomous", [](RobotDeviceInterfaces *robot){
-        big_side_autonomous(robot, false);
+        run_for_alliance(big_side_autonomous, robot, ALLIANCE_RED);
     }},
     {"blue big autonomous", [](RobotDeviceInterfaces *robot){
-        big_side_autonomous(robot, true);
+        run_for_alliance(big_side_autonomous, robot, ALLIANCE_BLUE);
     }},
     {"Unfold", [](RobotDeviceInterfaces *robot){
         unfold(robot);
+    }},
+    {"SD card script", [](RobotDeviceInterfaces *robot){
+        if(!autonomous_script.is_compiled()){
+            std::cout << "No autonomous script on the SD card\n";
+        }
+        autonomous_script.run(robot);
+    }}
+};
+
+// Selecting this tool makes driver control run on the simulator rather than
+// the robot. It does nothing in autonomous.
+const char *SIMULATED_DRIVER_CONTROL = "Simulated driver control";
+
+// Benchmarks, tuning and simulator runs. They are listed apart from the match
+// programs and the choice is never saved, so a brain restart can't leave one
+// selected for a match. A selected tool runs in place of the match program
+// the next time the robot is enabled in autonomous.
+int tool_selection = -1; // -1 when no tool is selected
+std::vector<std::tuple<std::string, void (*)(RobotDeviceInterfaces*)>> tool_programs = {
+    {"Benchmark", [](RobotDeviceInterfaces *robot){
+        run_benchmarks(robot);
+    }},
+    {"Drive backend comparison", [](RobotDeviceInterfaces *robot){
+        // Both backends are built on the native drive, whichever one autonomous uses
+        compare_drive_backends(global_robot);
+    }},
+    {"Simulated drive backend comparison", [](RobotDeviceInterfaces *robot){
+        get_simulator()->reset(SIMULATED_START);
+        compare_drive_backends(simulated_robot());
+    }},
+    {"Simulated small autonomous", [](RobotDeviceInterfaces *robot){
+        run_simulated(four_point_autonomous);
+    }},
+    {"Simulated big autonomous", [](RobotDeviceInterfaces *robot){
+        run_simulated(big_side_autonomous);
+    }},
+    {SIMULATED_DRIVER_CONTROL, [](RobotDeviceInterfaces *robot){
+        std::cout << "Enable driver control to drive the simulator\n";
+    }},
+    {"Simulated arm and tray tuning", [](RobotDeviceInterfaces *robot){
+        get_simulator()->reset(SIMULATED_START);
+        tune_position_gains(simulated_robot(), false);
+    }},
+    {"Arm and tray tuning", [](RobotDeviceInterfaces *robot){
+        tune_position_gains(global_robot, true);
+    }},
+    {"Turn scrub calibration", [](RobotDeviceInterfaces *robot){
+        calibrate_turn_scrub(global_robot);
     }}
 };
 
-void draw_unselect(int i){
-    pros::lcd::print(i + 1, "  %s", std::get<0>(autonomous_programs[i]));
+// The selection is saved to the SD card by name, so it survives a brain restart
+// and still points at the right program if the list is reordered.
+const char *AUTONOMOUS_SELECTION_FILE = "/usd/autonomous.txt";
+
+void save_autonomous_selection(){
+    FILE *file = fopen(AUTONOMOUS_SELECTION_FILE, "w");
+    if(file == NULL){
+        std::cout << "Could not save autonomous selection\n";
+        return;
+    }
+
+    fputs(std::get<0>(autonomous_programs[autonomous_selection]).c_str(), file);
+    fclose(file);
 }
 
-void draw_select(int i){
-    pros::lcd::print(i + 1, "> %s", std::get<0>(autonomous_programs[i]));
+void load_autonomous_selection(){
+    autonomous_selection = default_autonomous_selection;
+
+    FILE *file = fopen(AUTONOMOUS_SELECTION_FILE, "r");
+    if(file == NULL){
+        return;
+    }
+
+    char name[64] = {0};
+    fgets(name, sizeof(name), file);
+    fclose(file);
+
+    for(int i = 0; i < autonomous_programs.size(); i++){
+        if(std::get<0>(autonomous_programs[i]) == name){
+            autonomous_selection = i;
+        }
+    }
+
+    std::cout << "Loaded autonomous selection: " << std::get<0>(autonomous_programs[autonomous_selection]) << "\n";
+}
+
+RobotDeviceInterfaces *driver_control_robot(){
+    int tool = tool_selection;
+    if(tool < 0 || std::get<0>(tool_programs[tool]) != SIMULATED_DRIVER_CONTROL){
+        return global_robot;
+    }
+
+    Simulator *simulator = get_simulator();
+    simulator->reset(SIMULATED_START);
+    simulator->place_cubes(SIMULATED_FIRST_CUBE, SIMULATED_CUBE_SPACING, 4);
+    std::cout << "Driver control is running on the simulator\n";
+    return simulated_robot();
+}
+
+const char *get_autonomous_name(){
+    if(tool_selection >= 0){
+        return std::get<0>(tool_programs[tool_selection]).c_str();
+    }
+    return std::get<0>(autonomous_programs[autonomous_selection]).c_str();
+}
+
+// The selector is two LVGL lists, the match programs and the tools, with one
+// toggle button per entry. LVGL calls select_autonomous and select_tool from
+// its own task when a button is released, so nothing has to poll the screen.
+// Printing and saving the selection are left to the UI task so a slow SD card
+// can't hold up the screen.
+std::vector<lv_obj_t*> autonomous_buttons;
+std::vector<lv_obj_t*> tool_buttons;
+
+void update_selector_buttons(){
+    for(int i = 0; i < (int) autonomous_buttons.size(); i++){
+        bool selected = tool_selection < 0 && i == autonomous_selection;
+        lv_btn_set_state(autonomous_buttons[i], selected ? LV_BTN_STATE_TGL_REL : LV_BTN_STATE_REL);
+    }
+    for(int i = 0; i < (int) tool_buttons.size(); i++){
+        lv_btn_set_state(tool_buttons[i], i == tool_selection ? LV_BTN_STATE_TGL_REL : LV_BTN_STATE_REL);
+    }
+}
+
+UiQueue *get_selector_log(){
+    static UiQueue *log = ui_queue();
+    return log;
+}
+
+lv_res_t select_autonomous(lv_obj_t *button){
+    autonomous_selection = lv_obj_get_free_num(button);
+    tool_selection = -1;
+    update_selector_buttons();
+
+    ui_printf(get_selector_log(), "Selected autonomous: %s", get_autonomous_name());
+    ui_defer(get_selector_log(), save_autonomous_selection);
+
+    return LV_RES_OK;
+}
+
+lv_res_t select_tool(lv_obj_t *button){
+    tool_selection = lv_obj_get_free_num(button);
+    update_selector_buttons();
+
+    ui_printf(get_selector_log(), "Selected tool: %s", get_autonomous_name());
+
+    return LV_RES_OK;
 }
 
 void competition_initialize() {
 	std::cout << "Competition initialize\n";
 
-	pros::lcd::initialize();
-	pros::lcd::print(0, "Select autonomous:");
+    if(!autonomous_buttons.empty()){
+        return;
+    }
 
-    // Don't ask me why the extra text is required. It works so don't change it.
-    pros::lcd::print(7, "   Up                                       Down   kjascdjknsa");
+    // The selector gets its own screen so the telemetry dashboard can replace
+    // it once the match starts.
+    lv_obj_t *screen = lv_obj_create(NULL, NULL);
+    lv_scr_load(screen);
+
+    lv_obj_t *title = lv_label_create(screen, NULL);
+    lv_label_set_text(title, "Select autonomous:");
+    lv_obj_align(title, NULL, LV_ALIGN_IN_TOP_LEFT, 10, 5);
+
+    lv_obj_t *list = lv_list_create(screen, NULL);
+    lv_obj_set_size(list, LV_HOR_RES / 2 - 15, LV_VER_RES - 40);
+    lv_obj_align(list, title, LV_ALIGN_OUT_BOTTOM_LEFT, 0, 5);
 
     for(int i = 0; i < autonomous_programs.size(); i++){
-        draw_unselect(i);
+        lv_obj_t *button = lv_list_add(list, NULL, std::get<0>(autonomous_programs[i]).c_str(), select_autonomous);
+        lv_obj_set_free_num(button, i);
+        lv_btn_set_toggle(button, true);
+        autonomous_buttons.push_back(button);
     }
-    autonomous_selection = default_autonomous_selection;
-    draw_select(autonomous_selection);
-
-    int button_state = 0;
-
-	while(true){
-        if(button_state == 0){
-            if(pros::lcd::read_buttons() & LCD_BTN_LEFT){
-                button_state = -1;
-            } else if(pros::lcd::read_buttons() & LCD_BTN_RIGHT){
-                button_state = 1;
-            } else {
-                button_state = 0;
-            }
-
-            if(button_state != 0){
-                draw_unselect(autonomous_selection);
-                autonomous_selection = eucmod(autonomous_selection + button_state, autonomous_programs.size());
-                draw_select(autonomous_selection);
-            }
-        } else {
-            if(pros::lcd::read_buttons() == 0){
-                button_state = 0;
-            }
-        }
 
-		pros::delay(10);
-	}
+    lv_obj_t *tool_title = lv_label_create(screen, NULL);
+    lv_label_set_text(tool_title, "Tools:");
+    lv_obj_align(tool_title, NULL, LV_ALIGN_IN_TOP_LEFT, LV_HOR_RES / 2 + 5, 5);
+
+    lv_obj_t *tool_list = lv_list_create(screen, NULL);
+    lv_obj_set_size(tool_list, LV_HOR_RES / 2 - 15, LV_VER_RES - 40);
+    lv_obj_align(tool_list, tool_title, LV_ALIGN_OUT_BOTTOM_LEFT, 0, 5);
 
+    for(int i = 0; i < tool_programs.size(); i++){
+        lv_obj_t *button = lv_list_add(tool_list, NULL, std::get<0>(tool_programs[i]).c_str(), select_tool);
+        lv_obj_set_free_num(button, i);
+        lv_btn_set_toggle(button, true);
+        tool_buttons.push_back(button);
+    }
+
+    update_selector_buttons();
+    lv_list_focus(autonomous_buttons[autonomous_selection], false);
 }
 
 /**
@@ -198,8 +396,15 @@ void autonomous() {
 
     RobotDeviceInterfaces *robot = global_robot;
     robot->activate_brakes();
+    telemetry_start(robot);
 
-    std::get<1>(autonomous_programs[autonomous_selection])(global_robot);
+    RobotDeviceInterfaces drive = drive_backend_robot(robot, AUTONOMOUS_DRIVE_BACKEND);
+    int tool = tool_selection;
+    if(tool >= 0){
+        std::get<1>(tool_programs[tool])(&drive);
+    } else {
+        std::get<1>(autonomous_programs[autonomous_selection])(&drive);
+    }
 
     std::cout << "Autonomous finish\n";
 }
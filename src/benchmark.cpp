@@ -0,0 +1,146 @@
+#include "main.h"
+#include "benchmark.h"
+#include "okapi/api/filter/emaFilter.hpp"
+#include "okapi/api/filter/medianFilter.hpp"
+#include "okapi/api/filter/ekfFilter.hpp"
+#include "okapi/impl/filter/velMathFactory.hpp"
+
+const char *BENCHMARK_RESULTS_FILE = "/usd/benchmarks.csv";
+
+volatile double benchmark_sink;
+
+FILE *benchmark_file = NULL;
+
+void benchmark_record(const char *name, double nanoseconds){
+    printf("benchmark %s: %.0f ns\n", name, nanoseconds);
+    if(benchmark_file != NULL){
+        fprintf(benchmark_file, "%s,%s,%.0f\n", GIT_VERSION, name, nanoseconds);
+    }
+}
+
+void benchmark_record_value(const char *name, double value, const char *unit){
+    printf("benchmark %s: %.2f %s\n", name, value, unit);
+    if(benchmark_file != NULL){
+        fprintf(benchmark_file, "%s,%s (%s),%.2f\n", GIT_VERSION, name, unit, value);
+    }
+}
+
+void benchmark_open(){
+    benchmark_file = fopen(BENCHMARK_RESULTS_FILE, "a");
+    if(benchmark_file == NULL){
+        std::cout << "No SD card, benchmark results are only printed\n";
+    }
+}
+
+void benchmark_close(){
+    if(benchmark_file != NULL){
+        fclose(benchmark_file);
+        benchmark_file = NULL;
+    }
+}
+
+// Stand-ins for the motor systems, so the cost of the control code can be
+// measured without the cost of talking to the motors
+class DoneBlockCommand: public BlockCommand {
+public:
+    virtual bool check() override {
+        return true;
+    }
+};
+
+DoneBlockCommand done_command;
+
+class NullLinearMotorSystem final: public LinearMotorSystem {
+public:
+    virtual void move_velocity(okapi::QAngularSpeed velocity) override {}
+    virtual BlockCommand *move_distance(okapi::QLength distance) override { return &done_command; }
+    virtual void set_speed(okapi::QAngularSpeed speed) override {}
+    virtual okapi::QLength get_distance() override { return 0_in; }
+    virtual okapi::QAngularSpeed get_max_velocity() override { return 200_rpm; }
+    virtual okapi::QSpeed get_linear_velocity() override { return 0 * okapi::mps; }
+    virtual okapi::QSpeed get_max_linear_velocity() override { return 1 * okapi::mps; }
+    virtual void move_linear_velocity(okapi::QSpeed velocity) override {}
+};
+
+class NullAngularMotorSystem final: public AbsoluteAngularMotorSystem {
+public:
+    virtual void move_velocity(okapi::QAngularSpeed velocity) override {}
+    virtual BlockCommand *move_angle(okapi::QAngle angle) override { return &done_command; }
+    virtual void set_speed(okapi::QAngularSpeed speed) override {}
+    virtual BlockCommand *move_to_angle(okapi::QAngle angle) override { return &done_command; }
+    virtual okapi::QAngle get_angle() override { return 0_rot; }
+};
+
+RobotDeviceInterfaces null_robot(RobotDeviceInterfaces *robot){
+    static NullLinearMotorSystem linear;
+    static NullAngularMotorSystem angular;
+
+    RobotDeviceInterfaces null = *robot;
+    null.left_drive = null.right_drive = null.straight_drive = &linear;
+    null.roller = null.stack_setdown = &linear;
+    null.turn_drive = null.tray = null.arm = &angular;
+    return null;
+}
+
+void benchmark_block_commands(RobotDeviceInterfaces *robot){
+    // A balanced tree of 8 commands, as deep as the parallel blocks get
+    BlockCommand *chain = &done_command;
+    for(int i = 0; i < 3; i++){
+        chain = both(chain, chain);
+    }
+    benchmark("both() x8 check", [&]{ benchmark_sink = chain->check(); });
+
+    BlockCommand *motor = robot->straight_drive->move_distance(0_in);
+    benchmark("straight_drive move_distance check", [&]{ benchmark_sink = motor->check(); });
+}
+
+void benchmark_filters(){
+    double input = 0;
+
+    okapi::EmaFilter ema(0.2);
+    benchmark("EmaFilter", [&]{ benchmark_sink = ema.filter(input++); });
+
+    okapi::MedianFilter<5> median;
+    benchmark("MedianFilter<5>", [&]{ benchmark_sink = median.filter(input++); });
+
+    okapi::EKFFilter ekf;
+    benchmark("EKFFilter", [&]{ benchmark_sink = ekf.filter(input++); });
+
+    // Seven channels per call, one for each motor
+    FilterBank<7> bank({std::make_shared<EmaBankStage<7>>(0.2)});
+    float readings[7] = {};
+    benchmark("FilterBank<7> EMA", [&]{
+        readings[0] = input++;
+        benchmark_sink = bank.filter(readings)[0];
+    });
+
+    // The power manager's median of three over every motor's current
+    FilterBank<8> medians({std::make_shared<MedianBankStage<8, 3>>()});
+    float currents[8] = {};
+    benchmark("FilterBank<8> median of 3", [&]{
+        currents[0] = input++;
+        benchmark_sink = medians.filter(currents)[0];
+    });
+
+    okapi::VelMath velocity = okapi::VelMathFactory::create(okapi::imev5TPR);
+    benchmark("VelMath", [&]{ benchmark_sink = velocity.step(input++).convert(okapi::rpm); });
+}
+
+void benchmark_motors(RobotDeviceInterfaces *robot){
+    benchmark("left_drive get_distance", [&]{ benchmark_sink = robot->left_drive->get_distance().convert(okapi::inch); });
+    benchmark("left_drive move_velocity", [&]{ robot->left_drive->move_velocity(0_rpm); });
+    benchmark("tray get_angle", [&]{ benchmark_sink = robot->tray->get_angle().convert(rotation); });
+}
+
+void run_benchmarks(RobotDeviceInterfaces *robot){
+    benchmark_open();
+
+    RobotDeviceInterfaces null = null_robot(robot);
+
+    benchmark_filters();
+    benchmark_block_commands(robot);
+    benchmark_motors(robot);
+    benchmark_opcontrol(&null);
+
+    benchmark_close();
+}
@@ -0,0 +1,134 @@
+#include "main.h"
+#include "calibration.h"
+#include <math.h>
+#include <stddef.h>
+
+const char *CALIBRATION_FILE = "/usd/calibration.bin";
+
+Calibration default_calibration(){
+    Calibration defaults = {};
+    defaults.magic = CALIBRATION_MAGIC;
+    defaults.version = CALIBRATION_VERSION;
+    defaults.size = sizeof(Calibration);
+    defaults.wheel_diameter = ROBOT_CONFIG.wheel_diameter.convert(okapi::inch);
+    defaults.inter_wheel_distance = ROBOT_CONFIG.inter_wheel_distance.convert(okapi::inch);
+    defaults.roller_radius = ROBOT_CONFIG.roller_radius.convert(okapi::inch);
+    defaults.tray_ratio = TrayGearRatio::ratio;
+    defaults.arm_ratio = ArmGearRatio::ratio;
+    for(PositionGains &gains: defaults.position_gains){
+        gains = {0, 0, 0, false};
+    }
+    return defaults;
+}
+
+Calibration calibration = default_calibration();
+
+// FNV-1a over the bytes before the checksum
+std::uint32_t calibration_checksum(const Calibration &c){
+    const std::uint8_t *bytes = (const std::uint8_t*) &c;
+    std::uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < offsetof(Calibration, checksum); i++){
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Returns why a calibration can't be used, or NULL if it can
+const char *calibration_problem(const Calibration &c){
+    if(c.magic != CALIBRATION_MAGIC || c.version != CALIBRATION_VERSION || c.size != sizeof(Calibration)){
+        return "it was saved by a different version";
+    }
+    if(c.checksum != calibration_checksum(c)){
+        return "its checksum doesn't match";
+    }
+    if(c.tray_ratio != TrayGearRatio::ratio || c.arm_ratio != ArmGearRatio::ratio){
+        return "it is for different gear ratios";
+    }
+    if(!(c.wheel_diameter > 0 && c.inter_wheel_distance > 0 && c.roller_radius > 0)){
+        return "it has a wheel size that isn't positive";
+    }
+    return NULL;
+}
+
+void load_calibration(){
+    FILE *file = fopen(CALIBRATION_FILE, "rb");
+    if(file == NULL){
+        return;
+    }
+
+    Calibration loaded;
+    size_t read = fread(&loaded, sizeof(Calibration), 1, file);
+    fclose(file);
+
+    const char *problem = read == 1 ? calibration_problem(loaded) : "it is too short";
+    if(problem != NULL){
+        std::cout << "Ignoring the calibration on the SD card because " << problem << "\n";
+        return;
+    }
+
+    calibration = loaded;
+    std::cout << "Loaded calibration\n";
+}
+
+void save_calibration(){
+    calibration.checksum = calibration_checksum(calibration);
+
+    FILE *file = fopen(CALIBRATION_FILE, "wb");
+    if(file == NULL){
+        std::cout << "Could not save calibration\n";
+        return;
+    }
+    fwrite(&calibration, sizeof(Calibration), 1, file);
+    fclose(file);
+}
+
+const okapi::QAngle SCRUB_CALIBRATION_TURN = 2 * rotation;
+const okapi::QAngularSpeed SCRUB_CALIBRATION_SPEED = 50 * okapi::rpm;
+const std::uint32_t SCRUB_CALIBRATION_SETTLE_TIME = 500; // ms
+
+void calibrate_turn_scrub(RobotDeviceInterfaces *robot){
+    if(!robot->heading->is_gyro_healthy()){
+        std::cout << "Turn scrub calibration needs the gyro\n";
+        return;
+    }
+
+    okapi::QAngle start_heading = robot->heading->get_heading();
+    okapi::QAngle start_encoder_heading = robot->heading->get_encoder_heading();
+
+    // Spinning in place, each wheel drives around a circle the inter wheel
+    // distance across. Scrub only makes the turn slower than this, which the
+    // deadline has room for.
+    double expected_time = to_rotations(SCRUB_CALIBRATION_TURN) * calibration.inter_wheel_distance
+        / calibration.wheel_diameter / to_rpm(SCRUB_CALIBRATION_SPEED) * 60000;
+    std::uint32_t deadline = command_deadline(expected_time);
+
+    // The wheels only have to turn, not to land on an angle, so a constant
+    // velocity spin is enough
+    std::uint32_t start_time = pros::millis();
+    robot->turn_drive->move_velocity(SCRUB_CALIBRATION_SPEED);
+    while(fabs((robot->heading->get_heading() - start_heading).convert(okapi::degree))
+            < SCRUB_CALIBRATION_TURN.convert(okapi::degree)){
+        if(pros::millis() - start_time > deadline){
+            robot->turn_drive->move_velocity(0_rpm);
+            std::cout << "Turn scrub calibration didn't finish its turn, nothing was saved\n";
+            return;
+        }
+        pros::delay(10);
+    }
+    robot->turn_drive->move_velocity(0_rpm);
+    pros::delay(SCRUB_CALIBRATION_SETTLE_TIME);
+
+    double turned = (robot->heading->get_heading() - start_heading).convert(okapi::degree);
+    double encoder_turned = (robot->heading->get_encoder_heading() - start_encoder_heading).convert(okapi::degree);
+
+    // The encoders read a turn as larger than it was by the ratio of the
+    // effective to the inter wheel distance they were read with. That is the
+    // estimator's, not the calibration's, which an earlier run this session
+    // may already have changed.
+    double inter_wheel_distance = robot->heading->get_inter_wheel_distance().convert(okapi::inch);
+    calibration.inter_wheel_distance = inter_wheel_distance * encoder_turned / turned;
+    save_calibration();
+
+    printf("Turned %.1f deg by gyro and %.1f deg by encoders, inter wheel distance is now %.3f in\n",
+        turned, encoder_turned, calibration.inter_wheel_distance);
+}
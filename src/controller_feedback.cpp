@@ -0,0 +1,102 @@
+#include "main.h"
+#include <string.h>
+
+// Minimum time between two updates sent to the controller
+const int CONTROLLER_SEND_PERIOD = 55; // ms
+
+void ControllerFeedback::task_fn(void *param){
+    ControllerFeedback *feedback = (ControllerFeedback*) param;
+    ProfiledLoop loop("Controller feedback", CONTROLLER_SEND_PERIOD);
+
+    while(true){
+        feedback->send_next();
+        loop.wait();
+    }
+}
+
+void ControllerFeedback::send_next(){
+    char text[CONTROLLER_COLUMNS + 1];
+    char pattern[sizeof(this->rumble_pattern)];
+    int line = -1;
+    bool rumble = false;
+
+    // Pick the update while holding the lock, but talk to the controller
+    // without it so posting never waits on a send.
+    this->mutex.take(TIMEOUT_MAX);
+    if(this->rumble_pending){
+        strcpy(pattern, this->rumble_pattern);
+        this->rumble_pending = false;
+        rumble = true;
+    } else {
+        for(int i = 0; i < CONTROLLER_LINES; i++){
+            int candidate = (this->next_line + i) % CONTROLLER_LINES;
+            if(this->lines[candidate].dirty && (line == -1 || this->lines[candidate].priority > this->lines[line].priority)){
+                line = candidate;
+            }
+        }
+
+        if(line != -1){
+            strcpy(text, this->lines[line].text);
+            this->lines[line].dirty = false;
+            this->next_line = (line + 1) % CONTROLLER_LINES;
+        }
+    }
+    this->mutex.give();
+
+    if(rumble){
+        this->controller->rumble(pattern);
+    } else if(line != -1){
+        if(this->controller->set_text(line, 0, text) == 1){
+            this->mutex.take(TIMEOUT_MAX);
+            strcpy(this->lines[line].shown, text);
+            this->mutex.give();
+        } else {
+            // Try again on a later send
+            this->mutex.take(TIMEOUT_MAX);
+            this->lines[line].dirty = true;
+            this->mutex.give();
+        }
+    }
+}
+
+void ControllerFeedback::set_line(int line, const char *text, FeedbackPriority priority){
+    if(line < 0 || line >= CONTROLLER_LINES){
+        return;
+    }
+
+    // Pad to the full width so the new text overwrites the old one without a
+    // separate clear_line
+    char padded[CONTROLLER_COLUMNS + 1];
+    snprintf(padded, sizeof(padded), "%-*s", CONTROLLER_COLUMNS, text);
+
+    this->mutex.take(TIMEOUT_MAX);
+    Line &slot = this->lines[line];
+    strcpy(slot.text, padded);
+    slot.priority = priority;
+    slot.dirty = strcmp(slot.shown, padded) != 0;
+    this->mutex.give();
+}
+
+void ControllerFeedback::rumble(const char *pattern){
+    this->mutex.take(TIMEOUT_MAX);
+    strncpy(this->rumble_pattern, pattern, sizeof(this->rumble_pattern) - 1);
+    this->rumble_pattern[sizeof(this->rumble_pattern) - 1] = '\0';
+    this->rumble_pending = true;
+    this->mutex.give();
+}
+
+ControllerFeedback::ControllerFeedback(pros::Controller *controller){
+    this->controller = controller;
+
+    for(int i = 0; i < CONTROLLER_LINES; i++){
+        this->lines[i].text[0] = '\0';
+        this->lines[i].shown[0] = '\0';
+        this->lines[i].priority = FEEDBACK_LOW;
+        this->lines[i].dirty = false;
+    }
+    this->next_line = 0;
+    this->rumble_pattern[0] = '\0';
+    this->rumble_pending = false;
+
+    this->task = new pros::Task(task_fn, this, TASK_PRIORITY_MIN + 1, TASK_STACK_DEPTH_DEFAULT, "Controller feedback");
+}
@@ -0,0 +1,218 @@
+#include "main.h"
+#include <algorithm>
+#include <math.h>
+
+// The sensor sends a new frame every 20ms
+const int VISION_PERIOD = 20; // ms
+
+// Horizontal field of view of the V5 vision sensor
+const double VISION_FOV_ANGLE = 75; // degrees
+
+// Objects narrower than this are noise or too far away to drive to
+const int VISION_MIN_WIDTH = 10; // pixels
+// How far a cube can move across the frame between frames and still be
+// matched to the same track
+const float TRACK_GATE = 30; // pixels
+const float TRACK_SMOOTHING = 0.5;
+const int TRACK_MIN_SEEN = 3; // frames
+const int TRACK_MAX_MISSED = 5; // frames
+
+// Fraction of the drive speed added to one side and taken from the other per
+// degree of bearing, and the most that can be
+const double CUBE_STEER_GAIN = 0.02;
+const double CUBE_STEER_MAX = 0.3;
+
+VisionFrameSource::VisionFrameSource(std::uint8_t port): vision(port, pros::E_VISION_ZERO_CENTER) {}
+
+int VisionFrameSource::read(pros::vision_object_s_t *objects, int capacity){
+    // A single batch read per frame. It returns PROS_ERR, which is INT32_MAX
+    // rather than negative, when there are no objects, which is the same as an
+    // empty frame here.
+    std::int32_t count = this->vision.read_by_size(0, capacity, objects);
+    if(count == PROS_ERR){
+        return 0;
+    }
+    return std::min(std::max((int) count, 0), capacity);
+}
+
+RecordedFrameSource::RecordedFrameSource(const char *path){
+    this->next_frame = 0;
+
+    FILE *file = fopen(path, "r");
+    if(file == NULL){
+        std::cout << "Could not open recorded frames " << path << "\n";
+        return;
+    }
+
+    char line[256];
+    while(fgets(line, sizeof(line), file) != NULL){
+        std::vector<pros::vision_object_s_t> frame;
+        char *position = line;
+        int x, y, width, height, length;
+        while(sscanf(position, " %d,%d,%d,%d%n", &x, &y, &width, &height, &length) == 4){
+            pros::vision_object_s_t object = {};
+            object.signature = 1;
+            object.x_middle_coord = x;
+            object.y_middle_coord = y;
+            object.width = width;
+            object.height = height;
+            object.left_coord = x - width / 2;
+            object.top_coord = y - height / 2;
+            frame.push_back(object);
+            position += length;
+        }
+
+        std::sort(frame.begin(), frame.end(), [](const pros::vision_object_s_t &a, const pros::vision_object_s_t &b){
+            return a.width * a.height > b.width * b.height;
+        });
+        this->frames.push_back(frame);
+    }
+    fclose(file);
+}
+
+int RecordedFrameSource::read(pros::vision_object_s_t *objects, int capacity){
+    if(this->frames.empty()){
+        return 0;
+    }
+
+    const std::vector<pros::vision_object_s_t> &frame = this->frames[this->next_frame];
+    this->next_frame = (this->next_frame + 1) % this->frames.size();
+
+    int count = std::min<int>(capacity, frame.size());
+    std::copy(frame.begin(), frame.begin() + count, objects);
+    return count;
+}
+
+void CubeTracker::task_fn(void *param){
+    CubeTracker *tracker = (CubeTracker*) param;
+    ProfiledLoop loop("Cube tracker", VISION_PERIOD);
+
+    while(true){
+        tracker->update();
+        loop.wait();
+    }
+}
+
+CubeTracker::CubeTracker(FrameSource *source){
+    this->source = source;
+    for(Track &track: this->tracks){
+        track.active = false;
+    }
+    this->target_valid = false;
+    this->target_bearing = 0_rot;
+    this->task = NULL;
+}
+
+void CubeTracker::start(){
+    if(this->task == NULL){
+        this->task = new pros::Task(task_fn, this, TASK_PRIORITY_DEFAULT - 1, TASK_STACK_DEPTH_DEFAULT, "Cube tracker");
+    }
+}
+
+void CubeTracker::update(){
+    int count = this->source->read(this->objects, VISION_MAX_OBJECTS);
+
+    bool matched[VISION_MAX_TRACKS] = {};
+    for(int i = 0; i < count; i++){
+        const pros::vision_object_s_t &object = this->objects[i];
+        if(object.signature == VISION_OBJECT_ERR_SIG || object.width < VISION_MIN_WIDTH){
+            continue;
+        }
+
+        // Nearest unmatched track inside the gate
+        int nearest = -1;
+        float nearest_distance = TRACK_GATE;
+        for(int j = 0; j < VISION_MAX_TRACKS; j++){
+            float distance = fabs(this->tracks[j].x - object.x_middle_coord);
+            if(this->tracks[j].active && !matched[j] && distance < nearest_distance){
+                nearest = j;
+                nearest_distance = distance;
+            }
+        }
+
+        if(nearest >= 0){
+            Track &track = this->tracks[nearest];
+            track.x += TRACK_SMOOTHING * (object.x_middle_coord - track.x);
+            track.width += TRACK_SMOOTHING * (object.width - track.width);
+            track.seen++;
+            track.missed = 0;
+            matched[nearest] = true;
+            continue;
+        }
+
+        for(int j = 0; j < VISION_MAX_TRACKS; j++){
+            if(!this->tracks[j].active){
+                this->tracks[j] = {true, (float) object.x_middle_coord, (float) object.width, 1, 0};
+                matched[j] = true;
+                break;
+            }
+        }
+    }
+
+    const Track *best = NULL;
+    for(int j = 0; j < VISION_MAX_TRACKS; j++){
+        Track &track = this->tracks[j];
+        if(!track.active){
+            continue;
+        }
+        if(!matched[j] && ++track.missed > TRACK_MAX_MISSED){
+            track.active = false;
+            continue;
+        }
+        if(track.seen >= TRACK_MIN_SEEN && track.missed == 0 && (best == NULL || track.width > best->width)){
+            best = &track;
+        }
+    }
+
+    this->target_mutex.take(TIMEOUT_MAX);
+    this->target_valid = best != NULL;
+    if(best != NULL){
+        this->target_bearing = best->x / VISION_FOV_WIDTH * VISION_FOV_ANGLE * okapi::degree;
+    }
+    this->target_mutex.give();
+}
+
+bool CubeTracker::get_bearing(okapi::QAngle *bearing){
+    this->target_mutex.take(TIMEOUT_MAX);
+    bool valid = this->target_valid;
+    *bearing = this->target_bearing;
+    this->target_mutex.give();
+    return valid;
+}
+
+class DriveToCubeBlockCommand: public BlockCommand {
+private:
+    RobotDeviceInterfaces *robot;
+    okapi::QLength start, distance;
+    okapi::QAngularSpeed speed;
+
+public:
+    // Steering happens here, so the command has to be blocked on to drive
+    virtual bool check() override {
+        if(this->robot->straight_drive->get_distance() - this->start >= this->distance){
+            this->robot->straight_drive->move_velocity(0_rpm);
+            return true;
+        }
+
+        double steer = 0;
+        okapi::QAngle bearing;
+        if(this->robot->vision != NULL && this->robot->vision->get_bearing(&bearing)){
+            steer = std::clamp(CUBE_STEER_GAIN * bearing.convert(okapi::degree), -CUBE_STEER_MAX, CUBE_STEER_MAX);
+        }
+
+        this->robot->left_drive->move_velocity((1 + steer) * this->speed);
+        this->robot->right_drive->move_velocity((1 - steer) * this->speed);
+        return false;
+    }
+
+    DriveToCubeBlockCommand(RobotDeviceInterfaces *robot, okapi::QLength distance, okapi::QAngularSpeed speed){
+        this->robot = robot;
+        this->start = robot->straight_drive->get_distance();
+        this->distance = distance;
+        this->speed = speed;
+    }
+};
+
+BlockCommand *drive_to_cube(RobotDeviceInterfaces *robot, okapi::QLength distance, okapi::QAngularSpeed speed){
+    return new DriveToCubeBlockCommand(robot, distance, speed);
+}
@@ -0,0 +1,137 @@
+#include "main.h"
+#include <math.h>
+
+const int HEADING_PERIOD = 10; // ms
+const std::uint32_t HEADING_HEARTBEAT_TIMEOUT = 100; // ms
+
+// Filter variances, in degrees squared. Encoder steps are trusted less than
+// their size suggests because of scrub, and the gyro reads in tenths of a
+// degree with about as much noise again.
+const double HEADING_ENCODER_VARIANCE = 0.01;
+const double HEADING_GYRO_VARIANCE = 0.04;
+
+// How far the encoders have to turn with the gyro reading zero before the gyro
+// is taken to be missing
+const double GYRO_MISSING_ANGLE = 20; // degrees
+
+GyroYawSensor::GyroYawSensor(std::uint8_t port, bool reversed): gyro(port) {
+    this->direction = reversed ? -1 : 1;
+}
+
+bool GyroYawSensor::get_yaw(okapi::QAngle *yaw){
+    // The gyro counts in tenths of a degree. A failed read returns PROS_ERR_F,
+    // or PROS_ERR from the integer layer underneath, either of which would be
+    // a turn of millions of degrees.
+    double value = this->gyro.get_value();
+    if(value == PROS_ERR_F || value == PROS_ERR){
+        return false;
+    }
+    *yaw = this->direction * value / 10.0 * okapi::degree;
+    return true;
+}
+
+SimulatedGyro::SimulatedGyro(std::function<okapi::QAngle()> truth, double drift){
+    this->truth = truth;
+    this->drift = drift;
+    this->start_time = pros::millis();
+}
+
+bool SimulatedGyro::get_yaw(okapi::QAngle *yaw){
+    double seconds = (pros::millis() - this->start_time) / 1000.0;
+    double degrees = this->truth().convert(okapi::degree) + this->drift * seconds;
+    *yaw = round(degrees * 10) / 10 * okapi::degree;
+    return true;
+}
+
+void HeadingEstimator::task_fn(void *param){
+    HeadingEstimator *estimator = (HeadingEstimator*) param;
+    ProfiledLoop loop("Heading", HEADING_PERIOD);
+    // Turns that lose their heading miss their deadline, so a stall is only
+    // logged
+    Heartbeat heartbeat("Heading", HEADING_HEARTBEAT_TIMEOUT, false);
+
+    while(true){
+        heartbeat.beat();
+        estimator->update();
+        loop.wait();
+    }
+}
+
+HeadingEstimator::HeadingEstimator(LinearMotorSystem *left_drive, LinearMotorSystem *right_drive,
+        okapi::QLength inter_wheel_distance, YawSensor *gyro):
+    filter(HEADING_ENCODER_VARIANCE, HEADING_GYRO_VARIANCE)
+{
+    this->left_drive = left_drive;
+    this->right_drive = right_drive;
+    this->inter_wheel_distance = inter_wheel_distance;
+    this->gyro = gyro;
+    this->gyro_healthy = gyro != NULL;
+    this->gyro_responded = false;
+
+    this->start_encoder_yaw = this->get_encoder_heading();
+    this->previous_encoder_yaw = this->start_encoder_yaw;
+    this->skipped_step = 0;
+    this->encoder_travel = 0;
+    this->heading = 0;
+
+    this->task = new pros::Task(task_fn, this, TASK_PRIORITY_DEFAULT + 1, TASK_STACK_DEPTH_DEFAULT, "Heading");
+}
+
+void HeadingEstimator::update(){
+    okapi::QAngle encoder_yaw = this->get_encoder_heading();
+    double step = (encoder_yaw - this->previous_encoder_yaw).convert(okapi::degree);
+    this->previous_encoder_yaw = encoder_yaw;
+    this->encoder_travel += fabs(step);
+
+    okapi::QAngle gyro_yaw;
+    bool read = this->gyro_healthy && this->gyro->get_yaw(&gyro_yaw);
+    if(read && gyro_yaw.getValue() != 0){
+        this->gyro_responded = true;
+    }
+
+    // An unplugged gyro reads a steady zero, just like one that hasn't seen
+    // the robot turn yet, so zeros aren't fused until the gyro has shown it
+    // is there. Until then, and for a failed read, the filter predicts
+    // without correcting and is given the step with the next reading that
+    // counts, so its estimate doesn't fall behind.
+    if(this->gyro_healthy && (!read || !this->gyro_responded)){
+        if(!this->gyro_responded && this->encoder_travel > GYRO_MISSING_ANGLE){
+            std::cout << "Gyro is not responding, using the drive encoders for heading\n";
+            this->gyro_healthy = false;
+            // Nothing the gyro read has been fused, but start again from the
+            // encoders so the heading can't carry anything it pulled in
+            this->heading = (encoder_yaw - this->start_encoder_yaw).convert(okapi::degree);
+            return;
+        }
+        this->skipped_step += step;
+        this->heading += step;
+        return;
+    }
+
+    if(this->gyro_healthy){
+        this->heading = this->filter.filter(gyro_yaw.convert(okapi::degree), this->skipped_step + step);
+        this->skipped_step = 0;
+        return;
+    }
+
+    this->heading += step;
+}
+
+okapi::QAngle HeadingEstimator::get_heading(){
+    return (double) this->heading * okapi::degree;
+}
+
+okapi::QLength HeadingEstimator::get_inter_wheel_distance(){
+    return this->inter_wheel_distance;
+}
+
+okapi::QAngle HeadingEstimator::get_encoder_heading(){
+    // Wheels turning in opposite directions trace a circle with the inter
+    // wheel distance as its diameter
+    okapi::QLength difference = this->left_drive->get_distance() - this->right_drive->get_distance();
+    return (difference / this->inter_wheel_distance).getValue() * okapi::radian;
+}
+
+bool HeadingEstimator::is_gyro_healthy(){
+    return this->gyro_healthy;
+}
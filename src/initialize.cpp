@@ -1,7 +1,11 @@
 #include "main.h"
+#include "pid_tuning.h"
+#include "calibration.h"
+#include "ui_task.h"
 
 RobotDeviceInterfaces *global_robot;
 pros::Controller *global_controller;
+ControllerFeedback *global_feedback;
 
 /**
  * Runs initialization code. This occurs as soon as the program is started.
@@ -11,8 +15,24 @@ pros::Controller *global_controller;
  */
 void initialize() {
 	std::cout << "Initialize\n";
-	global_robot = new RobotDeviceInterfaces();
+	profiler_start();
+	ui_task_start();
+	load_calibration();
+	static RobotDeviceInterfaces robot;
+	global_robot = &robot;
+	supervisor_start(&robot);
 	global_controller = new pros::Controller(CONTROLLER_MASTER);
+	global_feedback = new ControllerFeedback(global_controller);
+	robot.intake->add_listener([](IntakeEvent event){
+		if(event == INTAKE_JAM){
+			global_feedback->rumble("-");
+		} else if(event == INTAKE_TRAY_FULL){
+			global_feedback->rumble("..");
+		}
+	});
+	load_position_gains(&robot);
+	load_autonomous_script();
+	load_autonomous_selection();
 	std::cout << "Initialization Finished\n";
 }
 
@@ -23,6 +43,7 @@ void initialize() {
  */
 void disabled() {
 	std::cout << "Disabled\n";
+	stop_driver_macros();
 	global_robot->deactivate_brakes();
 }
 
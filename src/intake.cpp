@@ -0,0 +1,194 @@
+#include "main.h"
+#include <algorithm>
+#include <math.h>
+
+const int INTAKE_PERIOD = 10; // ms
+
+// Rollers spinning slower than this are treated as idle
+const double INTAKE_MIN_TARGET_VELOCITY = 20; // RPM
+
+// Load signatures, tuned on the 36-gear rollers. Velocity is a ratio of actual
+// to target velocity so the thresholds work at any roller speed.
+const double INTAKE_LOADED_CURRENT = 900; // mA
+const double INTAKE_INGEST_VELOCITY_RATIO = 0.85;
+const double INTAKE_STALL_VELOCITY_RATIO = 0.2;
+const int INTAKE_MIN_INGEST_TICKS = 3;
+const int INTAKE_FULL_TICKS = 50;
+const int INTAKE_JAM_TICKS = 30;
+const double INTAKE_SMOOTHING = 0.3;
+
+// Rollers starting from rest draw a lot of current well below their target
+// velocity, which looks just like a cube. Loads aren't looked for until the
+// velocity ratio first reaches INTAKE_INGEST_VELOCITY_RATIO, or after this
+// many ticks if the rollers start against a cube and never get there.
+const int INTAKE_SPIN_UP_TICKS = 50;
+
+// The tray holds at most this many cubes
+const int INTAKE_TRAY_CAPACITY = 9;
+
+class IntakeCubeBlockCommand: public BlockCommand {
+private:
+    IntakeMonitor *monitor;
+    int target_count;
+
+public:
+    virtual bool check() override {
+        return this->monitor->get_cube_count() >= this->target_count
+            || this->monitor->get_state() == INTAKE_FULL;
+    }
+
+    IntakeCubeBlockCommand(IntakeMonitor *monitor, int target_count){
+        this->monitor = monitor;
+        this->target_count = target_count;
+    }
+};
+
+void IntakeMonitor::task_fn(void *param){
+    IntakeMonitor *monitor = (IntakeMonitor*) param;
+    ProfiledLoop loop("Intake monitor", INTAKE_PERIOD);
+
+    while(true){
+        monitor->update();
+        loop.wait();
+    }
+}
+
+void IntakeMonitor::emit(IntakeEvent event){
+    for(auto &listener: this->listeners){
+        listener(event);
+    }
+}
+
+void IntakeMonitor::set_state(IntakeState state){
+    IntakeState previous = this->state;
+    this->state = state;
+
+    if(state == INTAKE_JAMMED && previous != INTAKE_JAMMED){
+        std::cout << "Intake jammed\n";
+        this->emit(INTAKE_JAM);
+    } else if(previous == INTAKE_JAMMED && state != INTAKE_JAMMED){
+        this->emit(INTAKE_JAM_CLEARED);
+    }
+
+    if(state == INTAKE_FULL && previous != INTAKE_FULL){
+        std::cout << "Intake full\n";
+        this->emit(INTAKE_TRAY_FULL);
+    }
+}
+
+void IntakeMonitor::update(){
+    // The rollers intake when spinning backwards
+    double target = -(this->left_motor->get_target_velocity() + this->right_motor->get_target_velocity()) / 2.0;
+    double actual = -(this->left_motor->get_actual_velocity() + this->right_motor->get_actual_velocity()) / 2.0;
+    double current = (this->left_motor->get_current_draw() + this->right_motor->get_current_draw()) / 2.0;
+
+    // The velocity ratio means nothing while the rollers aren't intaking, so
+    // it restarts from 1 whenever they start again
+    bool running = target >= INTAKE_MIN_TARGET_VELOCITY;
+    float readings[INTAKE_CHANNEL_COUNT];
+    readings[INTAKE_CURRENT] = current;
+    readings[INTAKE_VELOCITY_RATIO] = running ? actual / target : 1;
+    const float *filtered = this->filters.filter(readings);
+
+    // reset_cube_count runs on other tasks
+    this->mutex.take(TIMEOUT_MAX);
+    this->step(running, target, filtered);
+    this->mutex.give();
+}
+
+void IntakeMonitor::step(bool running, double target, const float *filtered){
+    if(!running){
+        this->filters.reset(INTAKE_VELOCITY_RATIO, 1);
+        this->loaded_ticks = 0;
+        this->stalled_ticks = 0;
+        this->spin_up_ticks = 0;
+        this->spun_up = false;
+
+        // Spinning the rollers out empties the tray
+        if(this->state != INTAKE_FULL || target < -INTAKE_MIN_TARGET_VELOCITY){
+            this->set_state(INTAKE_IDLE);
+        }
+        return;
+    }
+
+    if(!this->spun_up){
+        this->spin_up_ticks++;
+        this->spun_up = filtered[INTAKE_VELOCITY_RATIO] >= INTAKE_INGEST_VELOCITY_RATIO
+            || this->spin_up_ticks >= INTAKE_SPIN_UP_TICKS;
+        if(!this->spun_up){
+            this->set_state(INTAKE_RUNNING);
+            return;
+        }
+    }
+
+    bool loaded = filtered[INTAKE_CURRENT] > INTAKE_LOADED_CURRENT
+        && filtered[INTAKE_VELOCITY_RATIO] < INTAKE_INGEST_VELOCITY_RATIO;
+    bool stalled = filtered[INTAKE_VELOCITY_RATIO] < INTAKE_STALL_VELOCITY_RATIO;
+
+    this->loaded_ticks = loaded ? this->loaded_ticks + 1 : 0;
+    this->stalled_ticks = stalled ? this->stalled_ticks + 1 : 0;
+
+    if(this->state == INTAKE_FULL){
+        return;
+    }
+
+    if(this->stalled_ticks >= INTAKE_JAM_TICKS){
+        this->set_state(INTAKE_JAMMED);
+    } else if(this->loaded_ticks >= INTAKE_FULL_TICKS){
+        this->set_state(INTAKE_FULL);
+    } else if(this->loaded_ticks >= INTAKE_MIN_INGEST_TICKS){
+        this->set_state(INTAKE_INGESTING);
+    } else if(this->state == INTAKE_INGESTING && !loaded){
+        // The load cleared, so the cube made it past the rollers
+        this->cube_count++;
+        this->set_state(INTAKE_RUNNING);
+        this->emit(INTAKE_CUBE_INGESTED);
+
+        if(this->cube_count >= INTAKE_TRAY_CAPACITY){
+            this->set_state(INTAKE_FULL);
+        }
+    } else if(!stalled) {
+        this->set_state(INTAKE_RUNNING);
+    }
+}
+
+IntakeState IntakeMonitor::get_state(){
+    return this->state;
+}
+
+int IntakeMonitor::get_cube_count(){
+    return this->cube_count;
+}
+
+void IntakeMonitor::reset_cube_count(){
+    this->mutex.take(TIMEOUT_MAX);
+    this->cube_count = 0;
+    if(this->state == INTAKE_FULL){
+        this->set_state(INTAKE_IDLE);
+    }
+    this->mutex.give();
+}
+
+void IntakeMonitor::add_listener(std::function<void(IntakeEvent)> listener){
+    this->listeners.push_back(listener);
+}
+
+BlockCommand *IntakeMonitor::wait_for_cubes(int count){
+    return new IntakeCubeBlockCommand(this, this->cube_count + count);
+}
+
+IntakeMonitor::IntakeMonitor(pros::Motor *left_motor, pros::Motor *right_motor){
+    this->left_motor = left_motor;
+    this->right_motor = right_motor;
+
+    this->state = INTAKE_IDLE;
+    this->cube_count = 0;
+    this->filters.addFilter(std::make_shared<EmaBankStage<INTAKE_CHANNEL_COUNT>>(INTAKE_SMOOTHING));
+    this->filters.reset(INTAKE_VELOCITY_RATIO, 1);
+    this->loaded_ticks = 0;
+    this->stalled_ticks = 0;
+    this->spin_up_ticks = 0;
+    this->spun_up = false;
+
+    this->task = new pros::Task(task_fn, this, TASK_PRIORITY_DEFAULT, TASK_STACK_DEPTH_DEFAULT, "Intake monitor");
+}
@@ -0,0 +1,447 @@
+#include "main.h"
+#include "okapi_drive.h"
+#include "benchmark.h"
+#include "calibration.h"
+#include "motor_templates.h"
+#include "okapi/api/chassis/controller/chassisControllerIntegrated.hpp"
+#include "okapi/api/chassis/model/skidSteerModel.hpp"
+#include "okapi/api/control/async/asyncMotionProfileController.hpp"
+#include "okapi/api/device/motor/abstractMotor.hpp"
+#include "okapi/impl/util/timeUtilFactory.hpp"
+#include <map>
+#include <math.h>
+#include <string>
+
+const char *DRIVE_BACKEND_NAMES[DRIVE_BACKEND_COUNT] = {"native", "okapi"};
+
+// Limits for the motion profiles on straight moves. The top speed is whatever
+// the straight drive's set_speed was.
+const double PROFILE_MAX_ACCELERATION = 1.0; // m/s^2
+const double PROFILE_MAX_JERK = 10.0; // m/s^3
+
+okapi::AbstractMotor::gearset okapi_gearset(pros::motor_gearset_e_t gearset){
+    switch(gearset){
+        case pros::E_MOTOR_GEARSET_36: return okapi::AbstractMotor::gearset::red;
+        case pros::E_MOTOR_GEARSET_06: return okapi::AbstractMotor::gearset::blue;
+        default: return okapi::AbstractMotor::gearset::green;
+    }
+}
+
+// okapi's chassis controllers take AbstractMotors, and okapi::Motor talks to
+// its port directly, so it can't be pointed at a SimulatedMotor. This adapter
+// forwards to any pros::Motor, which runs the okapi backend on the simulator
+// as well as on the robot.
+//
+// The robot configures its motors once, with every drive port in rotations,
+// so the settings okapi makes while it builds a chassis (units, gearing,
+// reversal, gains and voltage limits) are ignored rather than passed on.
+// Positions are always in rotations.
+class ProsMotorEncoder final: public okapi::ContinuousRotarySensor {
+private:
+    pros::Motor *motor;
+
+public:
+    virtual double get() const override {
+        return this->motor->get_position();
+    }
+
+    virtual double controllerGet() override {
+        return this->get();
+    }
+
+    virtual std::int32_t reset() override {
+        return this->motor->tare_position();
+    }
+
+    ProsMotorEncoder(pros::Motor *motor){
+        this->motor = motor;
+    }
+};
+
+class ProsMotorAdapter final: public okapi::AbstractMotor {
+private:
+    pros::Motor *motor;
+
+public:
+    virtual std::int32_t moveAbsolute(double position, std::int32_t velocity) override {
+        return this->motor->move_absolute(position, velocity);
+    }
+
+    virtual std::int32_t moveRelative(double position, std::int32_t velocity) override {
+        return this->motor->move_relative(position, velocity);
+    }
+
+    virtual std::int32_t moveVelocity(std::int16_t velocity) override {
+        return this->motor->move_velocity(velocity);
+    }
+
+    virtual std::int32_t moveVoltage(std::int16_t voltage) override {
+        return this->motor->move_voltage(voltage);
+    }
+
+    virtual std::int32_t modifyProfiledVelocity(std::int32_t velocity) override {
+        return this->motor->modify_profiled_velocity(velocity);
+    }
+
+    virtual void controllerSet(double value) override {
+        this->motor->move_velocity(value * to_rpm(gearset_max_velocity(this->motor->get_gearing())));
+    }
+
+    virtual double getTargetPosition() override { return this->motor->get_target_position(); }
+    virtual double getPosition() override { return this->motor->get_position(); }
+    virtual std::int32_t tarePosition() override { return this->motor->tare_position(); }
+    virtual std::int32_t getTargetVelocity() override { return this->motor->get_target_velocity(); }
+    virtual double getActualVelocity() override { return this->motor->get_actual_velocity(); }
+    virtual std::int32_t getCurrentDraw() override { return this->motor->get_current_draw(); }
+    virtual std::int32_t getDirection() override { return this->motor->get_direction(); }
+    virtual double getEfficiency() override { return this->motor->get_efficiency(); }
+    virtual std::int32_t isOverCurrent() override { return this->motor->is_over_current(); }
+    virtual std::int32_t isOverTemp() override { return this->motor->is_over_temp(); }
+    virtual std::int32_t isStopped() override { return this->motor->is_stopped(); }
+    virtual std::int32_t getZeroPositionFlag() override { return this->motor->get_zero_position_flag(); }
+    virtual uint32_t getFaults() override { return this->motor->get_faults(); }
+    virtual uint32_t getFlags() override { return this->motor->get_flags(); }
+    virtual std::int32_t getRawPosition(std::uint32_t *timestamp) override { return this->motor->get_raw_position(timestamp); }
+    virtual double getPower() override { return this->motor->get_power(); }
+    virtual double getTemperature() override { return this->motor->get_temperature(); }
+    virtual double getTorque() override { return this->motor->get_torque(); }
+    virtual std::int32_t getVoltage() override { return this->motor->get_voltage(); }
+
+    virtual std::int32_t setBrakeMode(brakeMode mode) override {
+        return this->motor->set_brake_mode((pros::motor_brake_mode_e_t) mode);
+    }
+
+    virtual brakeMode getBrakeMode() override {
+        return (brakeMode) this->motor->get_brake_mode();
+    }
+
+    virtual std::int32_t setCurrentLimit(std::int32_t limit) override {
+        return this->motor->set_current_limit(limit);
+    }
+
+    virtual std::int32_t getCurrentLimit() override {
+        return this->motor->get_current_limit();
+    }
+
+    virtual std::int32_t setEncoderUnits(encoderUnits) override { return 1; }
+    virtual encoderUnits getEncoderUnits() override { return encoderUnits::rotations; }
+    virtual std::int32_t setGearing(gearset) override { return 1; }
+    virtual gearset getGearing() override { return okapi_gearset(this->motor->get_gearing()); }
+    virtual std::int32_t setReversed(bool) override { return 1; }
+    virtual std::int32_t setVoltageLimit(std::int32_t) override { return 1; }
+    virtual std::int32_t setPosPID(double, double, double, double) override { return 1; }
+    virtual std::int32_t setPosPIDFull(double, double, double, double, double, double, double, double) override { return 1; }
+    virtual std::int32_t setVelPID(double, double, double, double) override { return 1; }
+    virtual std::int32_t setVelPIDFull(double, double, double, double, double, double, double, double) override { return 1; }
+
+    virtual std::shared_ptr<okapi::ContinuousRotarySensor> getEncoder() override {
+        return std::make_shared<ProsMotorEncoder>(this->motor);
+    }
+
+    ProsMotorAdapter(pros::Motor *motor){
+        this->motor = motor;
+    }
+};
+
+// Encoder units are set on the motor port, not on the object that set them,
+// so the okapi backend has to keep the drive in rotations like the rest of the
+// code expects. The chassis is given its scales in rotations instead of
+// degrees: rotations per meter driven, and rotations per degree turned.
+okapi::ChassisScales rotation_scales(okapi::QLength wheel_diameter, okapi::QLength inter_wheel_distance){
+    double straight = 1 / (okapi::pi * wheel_diameter.convert(okapi::meter));
+    double turn = (inter_wheel_distance / wheel_diameter).getValue() / 360;
+    return okapi::ChassisScales({straight, turn});
+}
+
+class OkapiDrive {
+public:
+    pros::Motor *left_motor, *right_motor;
+    std::shared_ptr<okapi::SkidSteerModel> model;
+    std::shared_ptr<okapi::ChassisControllerIntegrated> chassis;
+    okapi::QLength wheel_diameter;
+    okapi::QLength inter_wheel_distance;
+    okapi::AbstractMotor::GearsetRatioPair gearset;
+
+    // Profiles are limited to one top speed each, so there is one controller
+    // per speed the drive has been set to, started the first time it is used
+    std::map<int, okapi::AsyncMotionProfileController*> profiles;
+
+    okapi::AsyncMotionProfileController *get_profile(okapi::QAngularSpeed speed){
+        int rpm = lround(to_rpm(speed));
+        auto found = this->profiles.find(rpm);
+        if(found != this->profiles.end()){
+            return found->second;
+        }
+
+        // The profile follower drives the wheels by velocity, so it takes the
+        // real wheel size rather than the chassis scales
+        okapi::ChassisScales scales({this->wheel_diameter, this->inter_wheel_distance});
+        auto profile = new okapi::AsyncMotionProfileController(okapi::TimeUtilFactory::create(),
+            surface_speed(rpm * okapi::rpm, this->wheel_diameter).convert(okapi::mps),
+            PROFILE_MAX_ACCELERATION, PROFILE_MAX_JERK, this->model, scales, this->gearset);
+        profile->startThread();
+
+        this->profiles[rpm] = profile;
+        return profile;
+    }
+
+    OkapiDrive(pros::Motor *left_motor, pros::Motor *right_motor):
+            gearset(okapi_gearset(left_motor->get_gearing())) {
+        this->left_motor = left_motor;
+        this->right_motor = right_motor;
+        auto left = std::make_shared<ProsMotorAdapter>(left_motor);
+        auto right = std::make_shared<ProsMotorAdapter>(right_motor);
+
+        this->wheel_diameter = calibration.wheel_diameter * okapi::inch;
+        this->inter_wheel_distance = calibration.inter_wheel_distance * okapi::inch;
+        this->model = std::make_shared<okapi::SkidSteerModel>(left, right,
+            to_rpm(gearset_max_velocity(left_motor->get_gearing())));
+        this->chassis = std::make_shared<okapi::ChassisControllerIntegrated>(
+            okapi::TimeUtilFactory::create(), this->model,
+            std::make_unique<okapi::AsyncPosIntegratedController>(left, okapi::TimeUtilFactory::create()),
+            std::make_unique<okapi::AsyncPosIntegratedController>(right, okapi::TimeUtilFactory::create()),
+            this->gearset, rotation_scales(this->wheel_diameter, this->inter_wheel_distance));
+    }
+};
+
+class ProfileBlockCommand: public BlockCommand {
+private:
+    okapi::AsyncMotionProfileController *profile;
+
+public:
+    virtual bool check() override {
+        return this->profile == NULL || this->profile->isSettled();
+    }
+
+    // NULL for a move that has nothing to do
+    ProfileBlockCommand(okapi::AsyncMotionProfileController *profile){
+        this->profile = profile;
+    }
+};
+
+// Straight moves follow a motion profile. Paths are generated on the calling
+// task the first time each distance is asked for, which takes a moment, and
+// are kept after that. Everything else goes to the native drive, which reads
+// and commands the same motors.
+class OkapiStraightDrive final: public LinearMotorSystem {
+private:
+    OkapiDrive *drive;
+    LinearMotorSystem *native;
+    okapi::QAngularSpeed speed;
+
+public:
+    virtual void move_velocity(okapi::QAngularSpeed velocity) override {
+        this->native->move_velocity(velocity);
+    }
+
+    // Generates the path for a move of this distance at the current speed, if
+    // it hasn't been already, and returns its id. Either direction uses the
+    // same path.
+    std::string prepare(okapi::QLength distance){
+        long millimeters = lround(fabs(distance.convert(okapi::millimeter)));
+        okapi::AsyncMotionProfileController *profile = this->drive->get_profile(this->speed);
+        std::string path = std::to_string(millimeters);
+        for(const std::string &id: profile->getPaths()){
+            if(id == path){
+                return path;
+            }
+        }
+
+        profile->generatePath({
+            okapi::Point{0_in, 0_in, 0_deg},
+            okapi::Point{millimeters * okapi::millimeter, 0_in, 0_deg}
+        }, path);
+        return path;
+    }
+
+    virtual BlockCommand *move_distance(okapi::QLength distance) override {
+        if(lround(fabs(distance.convert(okapi::millimeter))) == 0){
+            return new ProfileBlockCommand(NULL);
+        }
+
+        std::string path = this->prepare(distance);
+        okapi::AsyncMotionProfileController *profile = this->drive->get_profile(this->speed);
+        profile->setTarget(path, distance.getValue() < 0);
+        return new ProfileBlockCommand(profile);
+    }
+
+    virtual void set_speed(okapi::QAngularSpeed speed) override {
+        this->speed = speed;
+        this->native->set_speed(speed);
+    }
+
+    virtual okapi::QLength get_distance() override {
+        return this->native->get_distance();
+    }
+
+    virtual okapi::QAngularSpeed get_max_velocity() override {
+        return this->native->get_max_velocity();
+    }
+
+    virtual okapi::QSpeed get_linear_velocity() override {
+        return this->native->get_linear_velocity();
+    }
+
+    virtual okapi::QSpeed get_max_linear_velocity() override {
+        return this->native->get_max_linear_velocity();
+    }
+
+    virtual void move_linear_velocity(okapi::QSpeed velocity) override {
+        this->native->move_linear_velocity(velocity);
+    }
+
+    OkapiStraightDrive(OkapiDrive *drive, LinearMotorSystem *native){
+        this->drive = drive;
+        this->native = native;
+        this->speed = 100_rpm;
+    }
+};
+
+// ChassisControllerIntegrated turns by moving both motors to an absolute
+// target, so a turn is done when both motors reach the target they were given
+class OkapiTurnBlockCommand: public BlockCommand {
+private:
+    OkapiDrive *drive;
+
+public:
+    virtual bool check() override {
+        for(pros::Motor *motor: {this->drive->left_motor, this->drive->right_motor}){
+            double error = motor->get_target_position() - motor->get_position();
+            if(fabs(error) >= MOTOR_TARGET_SIZE){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    OkapiTurnBlockCommand(OkapiDrive *drive){
+        this->drive = drive;
+    }
+};
+
+class OkapiTurnDrive final: public AngularMotorSystem {
+private:
+    OkapiDrive *drive;
+    AngularMotorSystem *native;
+
+public:
+    virtual void move_velocity(okapi::QAngularSpeed velocity) override {
+        this->native->move_velocity(velocity);
+    }
+
+    virtual BlockCommand *move_angle(okapi::QAngle angle) override {
+        this->drive->chassis->turnAngleAsync(angle);
+        return new OkapiTurnBlockCommand(this->drive);
+    }
+
+    virtual void set_speed(okapi::QAngularSpeed speed) override {
+        this->drive->chassis->setMaxVelocity(to_rpm(speed));
+        this->native->set_speed(speed);
+    }
+
+    OkapiTurnDrive(OkapiDrive *drive, AngularMotorSystem *native){
+        this->drive = drive;
+        this->native = native;
+        this->drive->chassis->setMaxVelocity(100);
+    }
+};
+
+struct OkapiBackend {
+    OkapiDrive drive;
+    OkapiStraightDrive straight;
+    OkapiTurnDrive turn;
+
+    OkapiBackend(RobotDeviceInterfaces *robot):
+        drive(robot->get_motors()[TELEMETRY_LEFT_DRIVE], robot->get_motors()[TELEMETRY_RIGHT_DRIVE]),
+        straight(&this->drive, robot->straight_drive),
+        turn(&this->drive, robot->turn_drive) {}
+};
+
+OkapiBackend *okapi_backend(RobotDeviceInterfaces *robot){
+    // One backend per set of drive motors, so the robot and the simulator each
+    // get their own. Views of a robot share its motors, and so its backend.
+    static std::map<pros::Motor*, OkapiBackend*> backends;
+    pros::Motor *left_motor = robot->get_motors()[TELEMETRY_LEFT_DRIVE];
+    auto found = backends.find(left_motor);
+    if(found == backends.end()){
+        found = backends.insert({left_motor, new OkapiBackend(robot)}).first;
+    }
+    return found->second;
+}
+
+RobotDeviceInterfaces drive_backend_robot(RobotDeviceInterfaces *robot, DriveBackend backend){
+    RobotDeviceInterfaces view = *robot;
+    if(backend == DRIVE_BACKEND_OKAPI){
+        OkapiBackend *okapi = okapi_backend(robot);
+        view.straight_drive = &okapi->straight;
+        view.turn_drive = &okapi->turn;
+    }
+    return view;
+}
+
+// Each segment starts from wherever the last one finished, so the set ends
+// about where it began
+struct DriveSegment {
+    const char *name;
+    okapi::QLength distance;
+    okapi::QAngle angle;
+};
+
+const DriveSegment DRIVE_SEGMENTS[] = {
+    {"24 in forward", 24_in, 0_deg},
+    {"90 deg turn", 0_in, 90_deg},
+    {"90 deg turn back", 0_in, -90_deg},
+    {"24 in back", -24_in, 0_deg},
+};
+
+void compare_drive_backends(RobotDeviceInterfaces *robot){
+    benchmark_open();
+
+    for(int b = 0; b < DRIVE_BACKEND_COUNT; b++){
+        RobotDeviceInterfaces view = drive_backend_robot(robot, (DriveBackend)b);
+        view.straight_drive->set_speed(100_rpm);
+        view.turn_drive->set_speed(100_rpm);
+
+        // The okapi paths are generated the first time each distance is
+        // driven, which would be timed as part of the segment. The native
+        // drive has nothing to prepare.
+        if(b == DRIVE_BACKEND_OKAPI){
+            for(const DriveSegment &segment: DRIVE_SEGMENTS){
+                if(segment.angle.getValue() == 0){
+                    okapi_backend(robot)->straight.prepare(segment.distance);
+                }
+            }
+        }
+
+        for(const DriveSegment &segment: DRIVE_SEGMENTS){
+            okapi::QLength start_distance = view.straight_drive->get_distance();
+            okapi::QAngle start_heading = view.heading->get_heading();
+            std::uint32_t start_time = pros::millis();
+
+            if(segment.angle.getValue() != 0){
+                view.turn_drive->move_angle(segment.angle)->block();
+            } else {
+                view.straight_drive->move_distance(segment.distance)->block();
+            }
+
+            std::uint32_t elapsed = pros::millis() - start_time;
+            // Let the robot settle before measuring where it ended up
+            pros::delay(250);
+
+            char name[64];
+            snprintf(name, sizeof(name), "%s %s time", DRIVE_BACKEND_NAMES[b], segment.name);
+            benchmark_record_value(name, elapsed, "ms");
+
+            snprintf(name, sizeof(name), "%s %s error", DRIVE_BACKEND_NAMES[b], segment.name);
+            if(segment.angle.getValue() != 0){
+                okapi::QAngle turned = view.heading->get_heading() - start_heading;
+                benchmark_record_value(name, (turned - segment.angle).convert(okapi::degree), "deg");
+            } else {
+                okapi::QLength travelled = view.straight_drive->get_distance() - start_distance;
+                benchmark_record_value(name, (travelled - segment.distance).convert(okapi::inch), "in");
+            }
+        }
+    }
+
+    benchmark_close();
+}
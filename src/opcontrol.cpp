@@ -1,10 +1,199 @@
 #include "main.h"
+#include "benchmark.h"
+#include "handoff.h"
+#include "ui_task.h"
+#include <atomic>
 #include <vector>
 
+// Driver control is split across four tasks by how urgent their work is:
+//
+// - The sensor task, at the highest priority, reads the controller and the
+//   mechanism state and publishes them as snapshots.
+// - The control task, which is the opcontrol task itself, runs the feedback
+//   controllers on the latest input snapshot and sets the motors. It never
+//   blocks or prints.
+// - The macro task runs the multi-step moves, like unfolding, that used to
+//   stall the control loop until they finished. The drive stays live while
+//   one runs, and the controllers for the mechanisms it moves are paused.
+// - The UI task, at the lowest priority, prints, updates the controller
+//   screen and writes to the SD card.
+//
+// Snapshots go through seqlocks and macros through a lock-free queue, so the
+// control task only ever waits for its next cycle.
+
 // The controller poll rate determines how long the controller will wait between
 // iterations of the control loop.
 const int CONTROLLER_POLL_RATE = 1000 / 30;
 
+const int SENSOR_PERIOD = 10; // ms
+
+// How long the sensor and control tasks can go without a cycle before the
+// supervisor stops the robot
+const std::uint32_t SENSOR_HEARTBEAT_TIMEOUT = 100; // ms
+const std::uint32_t CONTROL_HEARTBEAT_TIMEOUT = 250; // ms
+
+// The controller as the sensor task last read it
+struct DriverInput {
+	std::int32_t analog[4];
+	bool digital[DIGITAL_A - DIGITAL_L1 + 1];
+
+	std::int32_t get_analog(pros::controller_analog_e_t channel) const {
+		return this->analog[channel - ANALOG_LEFT_X];
+	}
+
+	bool get_digital(pros::controller_digital_e_t button) const {
+		return this->digital[button - DIGITAL_L1];
+	}
+};
+
+DriverInput read_driver_input(pros::Controller *controller){
+	DriverInput input;
+	for(int i = ANALOG_LEFT_X; i <= ANALOG_RIGHT_Y; i++){
+		input.analog[i - ANALOG_LEFT_X] = controller->get_analog((pros::controller_analog_e_t) i);
+	}
+	for(int i = DIGITAL_L1; i <= DIGITAL_A; i++){
+		input.digital[i - DIGITAL_L1] = controller->get_digital((pros::controller_digital_e_t) i);
+	}
+	return input;
+}
+
+// What the status lines show, read by the sensor task so the UI task doesn't
+// touch the motors
+struct DriverStatus {
+	int tray_angle; // degrees
+	int cube_count;
+};
+
+Seqlock<DriverInput> driver_input;
+Seqlock<DriverStatus> driver_status;
+
+// The robot driver control last started on, which is the simulated one while
+// the simulated driver control tool is selected
+std::atomic<RobotDeviceInterfaces*> driver_robot(NULL);
+
+void sensor_task_fn(void *param){
+	ProfiledLoop loop("Driver sensors", SENSOR_PERIOD);
+	Heartbeat heartbeat("Driver sensors", SENSOR_HEARTBEAT_TIMEOUT, true);
+
+	while(true){
+		RobotDeviceInterfaces *robot = driver_robot;
+		heartbeat.beat();
+		driver_input.publish(read_driver_input(global_controller));
+		driver_status.publish({
+			(int) robot->tray->get_angle().convert(okapi::degree),
+			robot->intake->get_cube_count()
+		});
+		loop.wait();
+	}
+}
+
+// Shows the selected autonomous, the tray state and the battery on the
+// controller screen. This runs on the UI task from the sensor task's
+// snapshot. Updates go through the ControllerFeedback queue, which only sends
+// what changed at the rate the controller accepts, so posting every cycle is
+// fine.
+void show_driver_status(){
+	DriverStatus status = driver_status.read();
+	char text[CONTROLLER_COLUMNS + 1];
+
+	global_feedback->set_line(0, get_autonomous_name(), FEEDBACK_LOW);
+
+	snprintf(text, sizeof(text), "Tray %2d Cubes %d", status.tray_angle, status.cube_count);
+	global_feedback->set_line(1, text, FEEDBACK_HIGH);
+
+	snprintf(text, sizeof(text), "Bat %d%% %.1fV", (int) pros::battery::get_capacity(),
+		pros::battery::get_voltage() / 1000.0);
+	global_feedback->set_line(2, text, FEEDBACK_NORMAL);
+}
+
+typedef void (*Macro)(RobotDeviceInterfaces *robot);
+
+// Each macro runs on the robot the controller that started it was driving
+struct QueuedMacro {
+	Macro macro;
+	RobotDeviceInterfaces *robot;
+};
+
+SpscQueue<QueuedMacro, 4> macro_queue;
+// Macros queued or running. The control task pauses every controller that
+// uses the arm, tray or rollers until this is back to zero.
+std::atomic<int> macros_pending(0);
+pros::Task *macro_task = NULL;
+UiQueue *macro_log = NULL;
+
+// Deleting the macro task from outside could stop it while it holds a mutex,
+// like the tray's profile mutex, so it is asked to stop instead. Its commands
+// are cancelled, and it exits once the macro returns.
+std::atomic<bool> macro_stop(false);
+std::atomic<bool> macro_running(false);
+
+void macro_task_fn(void *param){
+	QueuedMacro macro;
+
+	while(!macro_stop){
+		while(!macro_stop && macro_queue.pop(&macro)){
+			macro.macro(macro.robot);
+			macros_pending--;
+
+			// A macro that missed a deadline has given up by now, so the
+			// driver gets the robot back
+			supervisor_release(SAFE_DEADLINE);
+		}
+		pros::delay(10);
+	}
+
+	macro_running = false;
+	pros::c::task_delete(NULL);
+}
+
+// Only called from the control task
+void start_macro(Macro macro, RobotDeviceInterfaces *robot){
+	macros_pending++;
+	if(!macro_queue.push({macro, robot})){
+		macros_pending--;
+	}
+}
+
+void start_driver_tasks(RobotDeviceInterfaces *robot){
+	driver_robot = robot;
+
+	static pros::Task *sensor_task = NULL;
+	if(sensor_task == NULL){
+		macro_log = ui_queue();
+		sensor_task = new pros::Task(sensor_task_fn, NULL, TASK_PRIORITY_DEFAULT + 2,
+			TASK_STACK_DEPTH_DEFAULT, "Driver sensors");
+		ui_add_refresh(show_driver_status);
+	}
+
+	if(macro_task == NULL){
+		// The last macro task gives up within a cycle of being stopped, since
+		// its commands return at once
+		while(macro_running){
+			pros::delay(2);
+		}
+		macro_stop = false;
+		cancel_commands(NULL);
+
+		// Anything queued when the last macro task was stopped is dropped
+		QueuedMacro dropped;
+		while(macro_queue.pop(&dropped));
+		macros_pending = 0;
+
+		macro_running = true;
+		macro_task = new pros::Task(macro_task_fn, NULL, TASK_PRIORITY_DEFAULT,
+			TASK_STACK_DEPTH_DEFAULT, "Driver macros");
+	}
+}
+
+void stop_driver_macros(){
+	if(macro_task != NULL){
+		macro_stop = true;
+		cancel_commands(*macro_task);
+		delete macro_task;
+		macro_task = NULL;
+	}
+}
+
 // This class is an interface for the feedback control loop in the main
 // operator control function. The class splits up the measure phase (reading
 // controller input) and the act phase (setting motor speeds) so that the robot
@@ -14,11 +203,17 @@ class FeedbackController {
 public:
 	// The measure function is used to store controller state in a member
 	// variable
-	virtual void measure(pros::Controller *controller) = 0;
+	virtual void measure(const DriverInput &input) = 0;
 
 	// The act function is used to change the state of the motors based on the
 	// member variable
 	virtual void act(RobotDeviceInterfaces *robot) = 0;
+
+	// Controllers that use the arm, tray or rollers, or start macros, are
+	// paused while a macro runs
+	virtual bool uses_mechanisms() {
+		return true;
+	}
 };
 
 float cubic_control(float input){
@@ -27,21 +222,25 @@ float cubic_control(float input){
 
 class DrivetrainController: public FeedbackController {
 public:
-	int drive_speed, turn_speed; // in RPM
+	okapi::QAngularSpeed drive_speed, turn_speed;
 
-	const int BASE_DRIVE_SPEED = 200;
-	const int BASE_TURN_SPEED = 200;
+	const okapi::QAngularSpeed BASE_DRIVE_SPEED = 200_rpm;
+	const okapi::QAngularSpeed BASE_TURN_SPEED = 200_rpm;
 
-	void measure(pros::Controller *controller) override {
+	void measure(const DriverInput &input) override {
 		// Analog Joystick input come in an integer in the range -127..127. The
 		// top motor speed desired is 200rpm.
-		double drive_input = controller->get_analog(ANALOG_LEFT_Y) / 128.0;
-		double turn_input = controller->get_analog(ANALOG_LEFT_X) / 128.0;
+		double drive_input = input.get_analog(ANALOG_LEFT_Y) / 128.0;
+		double turn_input = input.get_analog(ANALOG_LEFT_X) / 128.0;
 
 		this->drive_speed = cubic_control(drive_input) * BASE_DRIVE_SPEED;
 		this->turn_speed = cubic_control(turn_input) * BASE_TURN_SPEED;
 	}
 
+	bool uses_mechanisms() override {
+		return false;
+	}
+
 	void act(RobotDeviceInterfaces *robot) override {
 		// left_drive and right_drive are used individually so both controls can
 		// be used at the same time.
@@ -51,27 +250,41 @@ public:
 	}
 };
 
+// How long to spin the rollers outwards to clear a jam
+const int JAM_REVERSE_TIME = 250; // ms
+
 class RollerController: public FeedbackController {
 public:
-	int roller_speed; // in RPM
+	okapi::QAngularSpeed roller_speed;
+	std::uint32_t reverse_until = 0;
 
-	void measure(pros::Controller *controller) override {
+	void measure(const DriverInput &input) override {
 		// When R2 is pressed, the roller will spin forwards, and when R1 is
 		// pressed the roller will spin backwards. The speed is set to 100rpm
-		this->roller_speed = (controller->get_digital(DIGITAL_R2) - controller->get_digital(DIGITAL_R1)) * 100;
+		this->roller_speed = (input.get_digital(DIGITAL_R2) - input.get_digital(DIGITAL_R1)) * 100_rpm;
 	}
 
 	void act(RobotDeviceInterfaces* robot) override {
-		robot->roller->move_velocity(this->roller_speed);
+		// If the intake jams while the driver is intaking, briefly reverse the
+		// rollers to spit the cube back out.
+		if(this->roller_speed < 0_rpm && robot->intake->get_state() == INTAKE_JAMMED){
+			this->reverse_until = pros::millis() + compensated_time(JAM_REVERSE_TIME);
+		}
+
+		if(pros::millis() < this->reverse_until){
+			robot->roller->move_velocity(100_rpm);
+		} else {
+			robot->roller->move_velocity(this->roller_speed);
+		}
 	}
 };
 
 class ArmController: public FeedbackController {
 public:
-	int arm_speed; // in RPM
+	okapi::QAngularSpeed arm_speed;
 
-	void measure(pros::Controller *controller) override {
-		this->arm_speed = (controller->get_digital(DIGITAL_L1) - controller->get_digital(DIGITAL_L2)) * 100;
+	void measure(const DriverInput &input) override {
+		this->arm_speed = (input.get_digital(DIGITAL_L1) - input.get_digital(DIGITAL_L2)) * 100_rpm;
 	}
 
 	void act(RobotDeviceInterfaces *robot) override {
@@ -82,44 +295,27 @@ public:
 class ArmRecenterController: public FeedbackController {
 public:
 	int command;
+	UiQueue *log;
 
-	void measure(pros::Controller *controller) override {
-		if(controller->get_digital(DIGITAL_X)){
+	void measure(const DriverInput &input) override {
+		if(input.get_digital(DIGITAL_X)){
 			this->command = 1;
-			std::cout << "Recenter commanded\n";
 		}
 	}
 
 	void act(RobotDeviceInterfaces *robot) override {
 		if(this->command == 1){
-			robot->arm->recenter();
+			ui_printf(this->log, "Recenter commanded");
+			start_macro([](RobotDeviceInterfaces *robot){
+				robot->arm->recenter();
+			}, robot);
 			this->command = 0;
 		}
 	}
-};
-
-// The LCDController is currently unused because we were unable to make the
-// controller API work.
-class LCDController: public FeedbackController {
-public:
-	int time;
-	int count;
-
-	void measure(pros::Controller *controller) override {
-		this->count++;
-	}
-
-	void act(RobotDeviceInterfaces *robot) override {
-		if(this->count % 10 == 0){
-			std::cout << "running controller feedback\n";
-			std::cout << "Clear result: " << std::to_string(robot->controller->clear_line(1)) << "\n";
-			std::cout << "Print result: " << std::to_string(robot->controller->set_text(1, 1, "Something")) << "\n";
-		}
-	}
 
-	LCDController(){
-		this->count = 0;
-		this->time = pros::millis();
+	ArmRecenterController(UiQueue *log){
+		this->command = 0;
+		this->log = log;
 	}
 };
 
@@ -130,24 +326,24 @@ class TrayController: public FeedbackController {
 public:
 	bool command;
 	bool flush;
-	int tray_velocity;
+	okapi::QAngularSpeed tray_velocity;
 
-	void measure(pros::Controller *controller) override {
-		bool a = controller->get_digital(DIGITAL_A);
-		bool b = controller->get_digital(DIGITAL_B);
+	void measure(const DriverInput &input) override {
+		bool a = input.get_digital(DIGITAL_A);
+		bool b = input.get_digital(DIGITAL_B);
 
 		if(a){
-			this->tray_velocity = 50;
+			this->tray_velocity = 50_rpm;
 			this->command = true;
 		}
 
 		if(b){
-			this->tray_velocity = -50;
+			this->tray_velocity = -50_rpm;
 			this->command = true;
 		}
 
 		if(!a && !b && this->command){
-			this->tray_velocity = 0;
+			this->tray_velocity = 0_rpm;
 			this->flush = true;
 		}
 	}
@@ -166,21 +362,24 @@ public:
 // The AutoBackupController is meant to be used when placing a stack of cubes
 // inside the scoring zone. After the tray is tilted forwards, we found that it
 // was hard to back away from the stack while making sure it is also properly
-// freed from the rollers. We found that this was best done by slowly backing up
-// while spinning the rollers at the same rate.
+// freed from the rollers. We found that this was best done by backing up while
+// spinning the rollers at the same surface speed, which the stack setdown system
+// matches every tick. That lets us back out as fast as the rollers can follow.
 class AutoBackupController: public FeedbackController {
 public:
 	int button_state;
 
-	void measure(pros::Controller *controller) override {
-		this->button_state = (controller->get_digital(DIGITAL_DOWN) - controller->get_digital(DIGITAL_RIGHT));
+	void measure(const DriverInput &input) override {
+		this->button_state = (input.get_digital(DIGITAL_DOWN) - input.get_digital(DIGITAL_RIGHT));
 	}
 
 	void act(RobotDeviceInterfaces* robot) override {
+		okapi::QAngularSpeed velocity = robot->stack_setdown->get_max_velocity();
+
 		if(this->button_state == 1){
-			robot->stack_setdown->move_velocity(50);
+			robot->stack_setdown->move_velocity(velocity);
 		} else if(this->button_state == -1){
-			robot->stack_setdown->move_velocity(-50);
+			robot->stack_setdown->move_velocity(-velocity);
 		}
 	}
 };
@@ -189,19 +388,19 @@ class AutoStackController: public FeedbackController {
 public:
 	int command;
 
-	void measure(pros::Controller *controller) override {
-		if(controller->get_digital(DIGITAL_UP)){
+	void measure(const DriverInput &input) override {
+		if(input.get_digital(DIGITAL_UP)){
 			this->command = 1;
-		} else if(controller->get_digital(DIGITAL_LEFT)){
+		} else if(input.get_digital(DIGITAL_LEFT)){
 			this->command = -1;
 		}
 	}
 
 	void act(RobotDeviceInterfaces *robot) override {
 		if(this->command == -1){
-			robot->tray->move_to_angle(0.04);
+			robot->tray->move_to_angle(0.04_rot);
 		} else if(this->command == 1){
-			robot->tray->move_to_angle(0.25);
+			robot->tray->move_to_angle(0.25_rot);
 		}
 
 		this->command = 0;
@@ -212,23 +411,71 @@ class AutoUnfoldController: public FeedbackController {
 public:
 	int command = 0;
 
-	void measure(pros::Controller *controller) override {
-		if(this->command == 0 && controller->get_digital(DIGITAL_Y)){
+	void measure(const DriverInput &input) override {
+		if(this->command == 0 && input.get_digital(DIGITAL_Y)){
 			this->command = 1;
 		}
 	}
 
 	void act(RobotDeviceInterfaces *robot) override {
 		if(this->command == 1){
-			std::uint32_t time_before = pros::millis();
-			unfold(robot);
-			std::uint32_t time_after = pros::millis();
-			std::cout << "Unfold time taken: " << time_after - time_before << "\n";
+			start_macro([](RobotDeviceInterfaces *robot){
+				std::uint32_t time_before = pros::millis();
+				unfold(robot);
+				std::uint32_t time_after = pros::millis();
+				ui_printf(macro_log, "Unfold time taken: %lu", (unsigned long) (time_after - time_before));
+			}, robot);
 			this->command = 2;
 		}
 	}
 };
 
+std::vector<FeedbackController*> make_feedback_controllers(UiQueue *log){
+	return {
+		new DrivetrainController(),
+		new RollerController(),
+		new ArmController(),
+		new ArmRecenterController(log),
+		new TrayController(),
+		new AutoBackupController(),
+		new AutoStackController(),
+		new AutoUnfoldController(),
+	};
+}
+
+void run_feedback_controllers(std::vector<FeedbackController*> &feedbackControllers,
+		const DriverInput &input, RobotDeviceInterfaces *robot){
+	bool paused = macros_pending > 0;
+
+	// Measure phase
+	for(auto feedbackController: feedbackControllers){
+		if(!paused || !feedbackController->uses_mechanisms()){
+			feedbackController->measure(input);
+		}
+	}
+
+	// Act phase
+	for(auto feedbackController: feedbackControllers){
+		if(!paused || !feedbackController->uses_mechanisms()){
+			feedbackController->act(robot);
+		}
+	}
+}
+
+void benchmark_opcontrol(RobotDeviceInterfaces *robot){
+	float input = 0;
+	benchmark("cubic_control", [&]{
+		benchmark_sink = cubic_control(input);
+		input += 0.001;
+	});
+
+	static std::vector<FeedbackController*> feedbackControllers = make_feedback_controllers(ui_queue());
+	DriverInput driver = read_driver_input(global_controller);
+	benchmark("opcontrol cycle", [&]{
+		run_feedback_controllers(feedbackControllers, driver, robot);
+	});
+}
+
 /**
  * Runs the operator control code. This function will be started in its own task
  * with the default priority and stack size whenever the robot is enabled via
@@ -246,38 +493,29 @@ void opcontrol(){
 	std::cout << "Driver control\n";
 
 	// Grab the global state pointers
-	RobotDeviceInterfaces *robot = global_robot;
+	RobotDeviceInterfaces *robot = driver_control_robot();
 	robot->activate_brakes();
+	telemetry_start(robot);
 
-	pros::Controller *controller = global_controller;
+	// Only one opcontrol task runs at a time, so they can share a queue
+	static UiQueue *log = ui_queue();
+	start_driver_tasks(robot);
+	pros::Task::current().set_priority(TASK_PRIORITY_DEFAULT + 1);
 
 	// Collect the FeedbackController implementations into a vector for
 	// iteration
-	std::vector<FeedbackController*> feedbackControllers = {
-		new DrivetrainController(),
-		new RollerController(),
-		new ArmController(),
-		new ArmRecenterController(),
-		new TrayController(),
-		new AutoBackupController(),
-		new AutoStackController(),
-		new AutoUnfoldController(),
-	};
+	std::vector<FeedbackController*> feedbackControllers = make_feedback_controllers(log);
 
+	// opcontrol is restarted every time the robot is enabled, so the loop
+	// outlives this task and only its schedule is reset
+	static ProfiledLoop loop("Opcontrol", CONTROLLER_POLL_RATE);
+	static Heartbeat heartbeat("Opcontrol", CONTROL_HEARTBEAT_TIMEOUT, true);
+	loop.restart();
 	while (true) {
-		std::uint32_t time = pros::millis();
-
-		// Measure phase
-		for(auto feedbackController: feedbackControllers){
-			feedbackController->measure(controller);
-		}
-
-		// Act phase
-		for(auto feedbackController: feedbackControllers){
-			feedbackController->act(robot);
-		}
+		heartbeat.beat();
+		run_feedback_controllers(feedbackControllers, driver_input.read(), robot);
 
 		// Wait for next cycle to save power
-		pros::Task::delay_until(&time, CONTROLLER_POLL_RATE);
+		loop.wait();
 	}
 }
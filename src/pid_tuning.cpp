@@ -0,0 +1,278 @@
+#include "main.h"
+#include "pid_tuning.h"
+#include "calibration.h"
+#include "okapi/impl/control/util/pidTunerFactory.hpp"
+#include <algorithm>
+#include <math.h>
+
+const char *POSITION_MECHANISM_NAMES[POSITION_MECHANISM_COUNT] = {"arm", "tray"};
+
+// Each trial moves the mechanism up from where it started by the test travel
+// and back. The travel is well inside the mechanism's range of motion, and the
+// gain ranges are where the search looks. Each range covers several steps of
+// the firmware's fixed point gains, or every result would round to the same
+// firmware gain.
+struct TuningSetup {
+    okapi::QAngle travel; // mechanism angle
+    double motor_ratio; // motor rotations per mechanism rotation
+    double kp_max, ki_max, kd_max;
+};
+
+const TuningSetup TUNING_SETUPS[POSITION_MECHANISM_COUNT] = {
+    {0.15 * rotation, ArmGearRatio::ratio, 0.02, 0.005, 0.005},
+    {0.1 * rotation, TrayGearRatio::ratio, 0.02, 0.005, 0.005},
+};
+
+const okapi::QTime TUNING_TRIAL_TIMEOUT = 2 * okapi::second;
+const int TUNING_ITERATIONS = 5;
+const int TUNING_PARTICLES = 16;
+
+// Going back to the start between trials
+const std::int32_t TUNING_RETURN_VELOCITY = 50; // RPM
+const double TUNING_RETURN_TOLERANCE = 1; // motor degrees
+const std::uint32_t TUNING_SETTLE_TIME = 250; // ms
+// A mechanism that can't get back in this long is jammed or at a hard stop,
+// so tuning is abandoned
+const std::uint32_t TUNING_RETURN_TIMEOUT = 3000; // ms
+
+// The firmware takes its gains in 4.4 fixed point, in its own units, which
+// PROS doesn't document. This scale from okapi's units is a guess, so tuned
+// gains are only kept if a move on the firmware loop with them settles, and
+// settles faster than with the gains the motors had before.
+const double FIRMWARE_GAIN_SCALE = 100;
+const double FIRMWARE_GAIN_STEP = 0.0625;
+const double FIRMWARE_GAIN_MAX = 15.9375;
+
+// The verification move, made by the firmware with move_absolute
+const std::int32_t TUNING_VERIFY_VELOCITY = 100; // RPM
+const double TUNING_VERIFY_TOLERANCE = 3; // motor degrees
+const double TUNING_VERIFY_OVERSHOOT = 0.1; // fraction of the travel
+const std::uint32_t TUNING_VERIFY_TIMEOUT = 3000; // ms
+
+// The tuner's view of the mechanism. It reads position in motor degrees from
+// the start of the trial and writes a voltage to every motor. The tuner stops
+// the output between trials, so the next read after a stop drives the
+// mechanism back to its start before the next trial begins.
+class MechanismTuningIO: public okapi::ControllerInput<double>, public okapi::ControllerOutput<double> {
+private:
+    std::vector<pros::Motor*> motors;
+    double start; // motor degrees
+    bool trial_finished;
+    bool failed;
+
+    double position(){
+        double total = 0;
+        for(pros::Motor *motor: this->motors){
+            total += motor->get_position();
+        }
+        return total / this->motors.size() * 360;
+    }
+
+    void stop(){
+        for(pros::Motor *motor: this->motors){
+            motor->move_velocity(0);
+        }
+    }
+
+public:
+    // Returns false, stopping the motors, if the mechanism didn't get back in
+    // time. Every trial after that is skipped with the motors off.
+    bool return_to_start(){
+        if(this->failed){
+            return false;
+        }
+
+        for(pros::Motor *motor: this->motors){
+            motor->move_absolute(this->start / 360, TUNING_RETURN_VELOCITY);
+        }
+        std::uint32_t start_time = pros::millis();
+        while(fabs(this->position() - this->start) > TUNING_RETURN_TOLERANCE){
+            if(pros::millis() - start_time > TUNING_RETURN_TIMEOUT){
+                this->stop();
+                this->failed = true;
+                std::cout << "Mechanism didn't return to its start, tuning abandoned\n";
+                return false;
+            }
+            pros::delay(10);
+        }
+        pros::delay(TUNING_SETTLE_TIME);
+        return true;
+    }
+
+    // Moves goal motor degrees from the start on the firmware's position loop
+    // with whatever gains the motors have. Returns how long it took to settle,
+    // or 0 if it didn't settle in time or overshot too far.
+    std::uint32_t verify_move(double goal){
+        for(pros::Motor *motor: this->motors){
+            motor->move_absolute((this->start + goal) / 360, TUNING_VERIFY_VELOCITY);
+        }
+
+        std::uint32_t start_time = pros::millis();
+        std::uint32_t settled_at = 0;
+        double overshoot = 0;
+        while(pros::millis() - start_time < TUNING_VERIFY_TIMEOUT){
+            double error = goal - (this->position() - this->start);
+            overshoot = std::max(overshoot, goal > 0 ? -error : error);
+
+            if(fabs(error) > TUNING_VERIFY_TOLERANCE){
+                settled_at = 0;
+            } else if(settled_at == 0){
+                settled_at = pros::millis();
+            } else if(pros::millis() - settled_at >= TUNING_SETTLE_TIME){
+                break;
+            }
+            pros::delay(10);
+        }
+
+        bool settled = settled_at != 0 && pros::millis() - settled_at >= TUNING_SETTLE_TIME;
+        if(!settled || overshoot > TUNING_VERIFY_OVERSHOOT * fabs(goal)){
+            return 0;
+        }
+        return settled_at - start_time;
+    }
+
+    bool has_failed(){
+        return this->failed;
+    }
+
+    virtual double controllerGet() override {
+        if(this->trial_finished){
+            this->return_to_start();
+            this->trial_finished = false;
+        }
+        return this->position() - this->start;
+    }
+
+    virtual void controllerSet(double value) override {
+        if(value == 0){
+            this->trial_finished = true;
+        }
+        if(this->failed){
+            value = 0;
+        }
+        for(pros::Motor *motor: this->motors){
+            motor->move_voltage(value * 12000);
+        }
+    }
+
+    MechanismTuningIO(std::vector<pros::Motor*> motors){
+        this->motors = motors;
+        this->start = this->position();
+        this->trial_finished = false;
+        this->failed = false;
+    }
+};
+
+std::vector<pros::Motor*> position_motors(RobotDeviceInterfaces *robot, PositionMechanism mechanism){
+    return mechanism == POSITION_ARM ? robot->get_arm_motors() : robot->get_tray_motors();
+}
+
+// The test travel in motor degrees
+double tuning_goal(PositionMechanism mechanism){
+    const TuningSetup &setup = TUNING_SETUPS[mechanism];
+    return to_rotations(setup.travel) * setup.motor_ratio * 360;
+}
+
+PositionGains autotune_position_gains(RobotDeviceInterfaces *robot, PositionMechanism mechanism){
+    const TuningSetup &setup = TUNING_SETUPS[mechanism];
+    std::vector<pros::Motor*> motors = position_motors(robot, mechanism);
+
+    std::cout << "Tuning " << POSITION_MECHANISM_NAMES[mechanism] << " position gains\n";
+
+    auto io = std::make_shared<MechanismTuningIO>(motors);
+    std::int32_t goal = lround(tuning_goal(mechanism));
+    auto tuner = okapi::PIDTunerFactory::createPtr(io, io, TUNING_TRIAL_TIMEOUT, goal,
+        0, setup.kp_max, 0, setup.ki_max, 0, setup.kd_max, TUNING_ITERATIONS, TUNING_PARTICLES);
+    okapi::PIDTuner::Output output = tuner->autotune();
+
+    bool returned = io->return_to_start();
+    for(pros::Motor *motor: motors){
+        motor->move_velocity(0);
+    }
+    if(!returned){
+        return {0, 0, 0, false};
+    }
+
+    printf("Tuned %s: kP %f kI %f kD %f\n", POSITION_MECHANISM_NAMES[mechanism], output.kP, output.kI, output.kD);
+    return {output.kP, output.kI, output.kD, true};
+}
+
+// Rounds to the nearest firmware step. A zero would leave the motor's gain as
+// it was instead of turning that term off, so the smallest gain sent is one
+// step.
+double firmware_gain(double gain){
+    double steps = round(gain * FIRMWARE_GAIN_SCALE / FIRMWARE_GAIN_STEP);
+    return std::min(std::max(steps * FIRMWARE_GAIN_STEP, FIRMWARE_GAIN_STEP), FIRMWARE_GAIN_MAX);
+}
+
+void apply_position_gains(RobotDeviceInterfaces *robot, PositionMechanism mechanism, const PositionGains &gains){
+    if(!gains.tuned){
+        return;
+    }
+
+    // Zeros leave the feedforward, filter, integral limit, threshold and loop
+    // speed as they were
+    pros::motor_pid_full_s_t pid = pros::Motor::convert_pid_full(0,
+        firmware_gain(gains.kp), firmware_gain(gains.ki), firmware_gain(gains.kd), 0, 0, 0, 0);
+
+    for(pros::Motor *motor: position_motors(robot, mechanism)){
+        motor->set_pos_pid_full(pid);
+    }
+}
+
+bool verify_position_gains(RobotDeviceInterfaces *robot, PositionMechanism mechanism, const PositionGains &gains){
+    if(!gains.tuned){
+        return false;
+    }
+
+    std::vector<pros::Motor*> motors = position_motors(robot, mechanism);
+    std::vector<pros::motor_pid_full_s_t> previous;
+    for(pros::Motor *motor: motors){
+        previous.push_back(motor->get_pos_pid());
+    }
+
+    MechanismTuningIO io(motors);
+    double goal = tuning_goal(mechanism);
+
+    std::uint32_t previous_time = io.verify_move(goal);
+    bool verified = false;
+    std::uint32_t tuned_time = 0;
+    if(io.return_to_start()){
+        apply_position_gains(robot, mechanism, gains);
+        tuned_time = io.verify_move(goal);
+        verified = io.return_to_start() && tuned_time != 0 && (previous_time == 0 || tuned_time <= previous_time);
+    }
+    for(pros::Motor *motor: motors){
+        motor->move_velocity(0);
+    }
+
+    printf("Verified %s: settled in %u ms with the tuned gains, %u ms before (0 is never)\n",
+        POSITION_MECHANISM_NAMES[mechanism], (unsigned int) tuned_time, (unsigned int) previous_time);
+
+    if(!verified){
+        for(size_t i = 0; i < motors.size(); i++){
+            motors[i]->set_pos_pid_full(previous[i]);
+        }
+        printf("Tuned %s gains rejected, keeping the previous ones\n", POSITION_MECHANISM_NAMES[mechanism]);
+    }
+    return verified;
+}
+
+void load_position_gains(RobotDeviceInterfaces *robot){
+    for(int i = 0; i < POSITION_MECHANISM_COUNT; i++){
+        apply_position_gains(robot, (PositionMechanism)i, calibration.position_gains[i]);
+    }
+}
+
+void tune_position_gains(RobotDeviceInterfaces *robot, bool save){
+    for(int i = 0; i < POSITION_MECHANISM_COUNT; i++){
+        PositionGains gains = autotune_position_gains(robot, (PositionMechanism)i);
+        if(verify_position_gains(robot, (PositionMechanism)i, gains) && save){
+            calibration.position_gains[i] = gains;
+        }
+    }
+
+    if(save){
+        save_calibration();
+    }
+}
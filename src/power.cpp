@@ -0,0 +1,223 @@
+#include "main.h"
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+
+const int POWER_PERIOD = 100; // ms
+
+// Total current shared by all motors, and the per motor range. The V5 motors
+// default to 2.5A each.
+const double POWER_TOTAL_BUDGET = 14000; // mA
+const double POWER_MOTOR_MAX_LIMIT = 2500; // mA
+const double POWER_MOTOR_MIN_LIMIT = 500; // mA
+
+// Priority weight of each group in each mode
+const double POWER_WEIGHTS[][POWER_GROUP_COUNT] = {
+    // drive, arm, tray, roller
+    {1.0, 0.5, 0.3, 0.6}, // POWER_DRIVING
+    {0.5, 0.3, 1.0, 0.6}, // POWER_STACKING
+};
+
+// Idle motors keep a small share so they can still hold position. A motor
+// counts as working from what it is doing rather than what it was told, since
+// a motor holding with move_absolute keeps its target velocity.
+const double POWER_IDLE_WEIGHT = 0.2;
+const double POWER_ACTIVE_CURRENT = 200; // mA
+const double POWER_ACTIVE_VELOCITY = 5; // RPM
+
+// Readings the current draw is the median of. A read that fails returns
+// PROS_ERR, which would otherwise count as a huge current.
+const std::size_t POWER_CURRENT_MEDIAN = 3;
+
+// The motors cut out at 55C. Limits are scaled down linearly from the start of
+// the derate range so the motor cools before it gets there.
+const double POWER_DERATE_START = 45; // Celsius
+const double POWER_DERATE_END = 55; // Celsius
+const double POWER_DERATE_MIN = 0.3;
+
+// The tray counts as moving, and the robot as stacking, above this speed
+const double POWER_STACKING_VELOCITY = 5; // RPM
+
+double thermal_derate(pros::Motor *motor){
+    if(motor->is_over_temp() == 1){
+        return POWER_DERATE_MIN;
+    }
+
+    double t = (motor->get_temperature() - POWER_DERATE_START) / (POWER_DERATE_END - POWER_DERATE_START);
+    t = std::min(std::max(t, 0.0), 1.0);
+    return 1 - t * (1 - POWER_DERATE_MIN);
+}
+
+void PowerManager::task_fn(void *param){
+    PowerManager *manager = (PowerManager*) param;
+    ProfiledLoop loop("Power manager", POWER_PERIOD);
+
+    while(true){
+        manager->update();
+        loop.wait();
+    }
+}
+
+void sample_battery_voltage();
+
+// There is a power manager for the robot and another for the simulator, but
+// only one battery. The first manager started samples it.
+std::atomic<PowerManager*> battery_sampler(NULL);
+
+void PowerManager::update(){
+    if(battery_sampler == this){
+        sample_battery_voltage();
+    }
+
+    if(this->tray_motor != NULL){
+        bool stacking = fabs(this->tray_motor->get_actual_velocity()) > POWER_STACKING_VELOCITY
+            || (this->tray_profile_active && this->tray_profile_active());
+        this->mode = stacking ? POWER_STACKING : POWER_DRIVING;
+    }
+
+    float readings[MAX_MOTORS] = {};
+    for(int i = 0; i < this->motor_count; i++){
+        readings[i] = this->motors[i].motor->get_current_draw();
+    }
+    const float *currents = this->currents.filter(readings);
+
+    double weights[MAX_MOTORS];
+    double total_weight = 0;
+
+    for(int i = 0; i < this->motor_count; i++){
+        pros::Motor *motor = this->motors[i].motor;
+        bool active = fabs(motor->get_actual_velocity()) > POWER_ACTIVE_VELOCITY
+            || currents[i] > POWER_ACTIVE_CURRENT;
+
+        weights[i] = POWER_WEIGHTS[this->mode][this->motors[i].group] * (active ? 1 : POWER_IDLE_WEIGHT);
+        total_weight += weights[i];
+    }
+
+    // Share out the budget above the per motor minimum by weight. Motors that
+    // hit the per motor maximum hand their excess back to the others.
+    double shares[MAX_MOTORS];
+    double remaining = POWER_TOTAL_BUDGET - this->motor_count * POWER_MOTOR_MIN_LIMIT;
+    bool capped[MAX_MOTORS] = {false};
+    for(int i = 0; i < this->motor_count; i++){
+        shares[i] = POWER_MOTOR_MIN_LIMIT;
+    }
+
+    for(int pass = 0; pass < this->motor_count && remaining > 0 && total_weight > 0; pass++){
+        double next_remaining = remaining;
+        double next_weight = total_weight;
+
+        for(int i = 0; i < this->motor_count; i++){
+            if(capped[i]){
+                continue;
+            }
+
+            double share = remaining * weights[i] / total_weight;
+            double headroom = POWER_MOTOR_MAX_LIMIT - shares[i];
+
+            if(share >= headroom){
+                shares[i] = POWER_MOTOR_MAX_LIMIT;
+                capped[i] = true;
+                next_remaining -= headroom;
+                next_weight -= weights[i];
+            } else {
+                shares[i] += share;
+                next_remaining -= share;
+            }
+        }
+
+        remaining = next_remaining;
+        total_weight = next_weight;
+    }
+
+    // Nothing gets any current while the supervisor has the robot in its safe
+    // state
+    bool safe = supervisor_safe_reasons() != 0;
+
+    for(int i = 0; i < this->motor_count; i++){
+        ManagedMotor &managed = this->motors[i];
+        std::int32_t limit = safe ? 0 : shares[i] * thermal_derate(managed.motor);
+
+        if(limit != managed.limit){
+            managed.motor->set_current_limit(limit);
+            managed.limit = limit;
+        }
+    }
+}
+
+void PowerManager::add_motor(pros::Motor *motor, PowerGroup group){
+    if(this->motor_count < MAX_MOTORS){
+        this->motors[this->motor_count++] = {motor, group, -1};
+    }
+}
+
+void PowerManager::set_tray(pros::Motor *motor, std::function<bool()> profile_active){
+    this->tray_motor = motor;
+    this->tray_profile_active = profile_active;
+}
+
+void PowerManager::start(){
+    PowerManager *none = NULL;
+    battery_sampler.compare_exchange_strong(none, this);
+
+    if(this->task == NULL){
+        this->task = new pros::Task(task_fn, this, TASK_PRIORITY_DEFAULT - 1, TASK_STACK_DEPTH_DEFAULT, "Power manager");
+    }
+}
+
+PowerMode PowerManager::get_mode(){
+    return this->mode;
+}
+
+PowerManager::PowerManager(){
+    this->motor_count = 0;
+    this->currents.addFilter(std::make_shared<MedianBankStage<MAX_MOTORS, POWER_CURRENT_MEDIAN>>());
+    this->tray_motor = NULL;
+    this->mode = POWER_DRIVING;
+    this->task = NULL;
+}
+
+// The battery voltage sags briefly under load, so it is smoothed over the last
+// few readings before it is used to scale anything.
+const double BATTERY_SMOOTHING = 0.2;
+const double BATTERY_MIN_COMPENSATION = 0.85;
+const double BATTERY_MAX_COMPENSATION = 1.3;
+
+// Only the power manager task writes this. Everything else reads it. 0 until
+// the first good reading.
+std::atomic<double> filtered_battery_voltage(0);
+
+void sample_battery_voltage(){
+    // Reading the battery fails with PROS_ERR, which is INT32_MAX, if another
+    // task holds the port
+    std::int32_t millivolts = pros::battery::get_voltage();
+    if(millivolts == PROS_ERR || millivolts <= 0){
+        return;
+    }
+    double voltage = millivolts / 1000.0;
+
+    double filtered = filtered_battery_voltage;
+    if(filtered == 0){
+        filtered = voltage;
+    } else {
+        filtered += BATTERY_SMOOTHING * (voltage - filtered);
+    }
+    filtered_battery_voltage = filtered;
+}
+
+double battery_voltage(){
+    double filtered = filtered_battery_voltage;
+    return filtered > 0 ? filtered : NOMINAL_BATTERY_VOLTAGE;
+}
+
+double battery_compensation(){
+    double compensation = NOMINAL_BATTERY_VOLTAGE / battery_voltage();
+    return std::min(std::max(compensation, BATTERY_MIN_COMPENSATION), BATTERY_MAX_COMPENSATION);
+}
+
+std::uint32_t compensated_time(std::uint32_t milliseconds){
+    return milliseconds * battery_compensation();
+}
+
+void compensated_delay(std::uint32_t milliseconds){
+    pros::delay(compensated_time(milliseconds));
+}
@@ -0,0 +1,113 @@
+#include "main.h"
+#include <algorithm>
+
+const int PROFILER_REPORT_PERIOD = 1000; // ms
+
+ProfiledLoop *profiled_loops[PROFILER_MAX_LOOPS];
+std::atomic<int> profiled_loop_count(0);
+
+// Latest summary, written by the profiler task
+std::atomic<double> profiler_latest_load(0);
+std::atomic<std::uint32_t> profiler_latest_lateness(0);
+
+ProfiledLoop::ProfiledLoop(const char *name, std::uint32_t period):
+    cycles(0), busy_time(0), lateness(0), overruns(0), max_lateness(0), reset_max(false)
+{
+    this->name = name;
+    this->period = period;
+    this->deadline = pros::millis();
+
+    // Loops register from their own tasks, so claim a slot atomically and
+    // publish the pointer once it is filled in
+    int index = profiled_loop_count.load();
+    while(index < PROFILER_MAX_LOOPS && !profiled_loop_count.compare_exchange_weak(index, index + 1)){}
+    if(index < PROFILER_MAX_LOOPS){
+        profiled_loops[index] = this;
+    } else {
+        std::cout << "Too many profiled loops, not profiling " << name << "\n";
+    }
+}
+
+void ProfiledLoop::wait(){
+    std::uint32_t now = pros::millis();
+    std::uint32_t busy = now - this->deadline;
+    this->busy_time += busy;
+    if(busy >= this->period){
+        this->overruns++;
+    }
+
+    pros::Task::delay_until(&this->deadline, this->period);
+
+    // delay_until has moved the deadline on to the start of this cycle
+    std::uint32_t late = pros::millis() - (this->deadline - this->period);
+    if(this->reset_max.exchange(false) || late > this->max_lateness){
+        this->max_lateness = late;
+    }
+    this->lateness += late;
+    this->cycles++;
+}
+
+void ProfiledLoop::restart(){
+    this->deadline = pros::millis();
+}
+
+struct LoopTotals {
+    std::uint32_t cycles, busy_time, lateness, overruns;
+};
+
+void profiler_task_fn(void *param){
+    LoopTotals previous[PROFILER_MAX_LOOPS] = {};
+    std::uint32_t time = pros::millis();
+
+    while(true){
+        pros::Task::delay_until(&time, PROFILER_REPORT_PERIOD);
+
+        double total_load = 0;
+        std::uint32_t worst_lateness = 0;
+
+        int count = std::min<int>(profiled_loop_count.load(), PROFILER_MAX_LOOPS);
+        for(int i = 0; i < count; i++){
+            ProfiledLoop *loop = profiled_loops[i];
+            if(loop == NULL){
+                continue;
+            }
+
+            LoopTotals totals = {loop->cycles, loop->busy_time, loop->lateness, loop->overruns};
+            LoopProfile profile;
+            profile.name = loop->name;
+            profile.max_lateness = loop->max_lateness;
+            loop->reset_max = true;
+
+            std::uint32_t cycles = totals.cycles - previous[i].cycles;
+            profile.load = (double) (totals.busy_time - previous[i].busy_time) / PROFILER_REPORT_PERIOD;
+            profile.mean_lateness = cycles > 0 ? (double) (totals.lateness - previous[i].lateness) / cycles : 0;
+            profile.overruns = totals.overruns - previous[i].overruns;
+            previous[i] = totals;
+
+            total_load += profile.load;
+            worst_lateness = std::max(worst_lateness, profile.max_lateness);
+
+            printf("profile %s: load %.0f%% late %.1f/%lums overruns %lu\n",
+                profile.name, profile.load * 100, profile.mean_lateness,
+                (unsigned long) profile.max_lateness, (unsigned long) profile.overruns);
+        }
+
+        profiler_latest_load = total_load;
+        profiler_latest_lateness = worst_lateness;
+    }
+}
+
+void profiler_start(){
+    static pros::Task *task = NULL;
+    if(task == NULL){
+        task = new pros::Task(profiler_task_fn, NULL, TASK_PRIORITY_MIN, TASK_STACK_DEPTH_DEFAULT, "Profiler");
+    }
+}
+
+double profiler_load(){
+    return profiler_latest_load;
+}
+
+std::uint32_t profiler_worst_lateness(){
+    return profiler_latest_lateness;
+}
@@ -1,10 +1,42 @@
 #include "main.h"
+#include "motor_templates.h"
+#include "simulator.h"
+#include "calibration.h"
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <math.h>
 
+// Commands rarely run more than a little over their expected time, so a
+// missed deadline means something is stuck
+const double DEADLINE_FACTOR = 1.5;
+const std::uint32_t DEADLINE_MARGIN = 1000; // ms
+
+std::uint32_t command_deadline(double expected_time){
+    return expected_time * DEADLINE_FACTOR + DEADLINE_MARGIN;
+}
+
+std::atomic<pros::task_t> cancelled_task(NULL);
+
+void cancel_commands(pros::task_t task){
+    cancelled_task = task;
+}
+
+bool commands_cancelled(){
+    pros::task_t task = cancelled_task;
+    return task != NULL && task == pros::c::task_get_current();
+}
+
 void BlockCommand::block() {
+    std::uint32_t start = pros::millis();
     while(!this->check()){
+        if(commands_cancelled() || (supervisor_safe_reasons() & SAFE_DEADLINE)){
+            return;
+        }
+        if(pros::millis() - start > this->deadline){
+            supervisor_deadline_missed();
+            return;
+        }
         pros::delay(2);
     }
 }
@@ -16,10 +48,8 @@ private:
 
 public:
 	virtual bool check() override {
-        const double TARGET_SIZE = 0.015;
-
         auto pos = this->motor->get_position();
-        return (pos < target_position + TARGET_SIZE) && (pos > target_position - TARGET_SIZE);
+        return (pos < target_position + MOTOR_TARGET_SIZE) && (pos > target_position - MOTOR_TARGET_SIZE);
     }
 
 	MotorBlockCommand(pros::Motor *motor, double target_position){
@@ -65,181 +95,372 @@ public:
 	MultiBlockCommand(BlockCommand* c1, BlockCommand* c2){
 		this->c1 = c1;
         this->c2 = c2;
+        this->deadline = std::max(c1->deadline, c2->deadline);
 	}
 };
 
-class WheelMotorSystem: public LinearMotorSystem {
-private:
-    pros::Motor *motor;
-    double diameter;
-    double speed;
-    // TODO: Add adjustable drive speed form move_distance
-
+class EitherBlockCommand: public BlockCommand {
 public:
+	BlockCommand *c1, *c2;
 
-    void move_velocity(double velocity) override {
-        this->motor->move_velocity(velocity);
-    }
+	virtual bool check() override {
+		return c1->check() || c2->check();
+	}
 
-    virtual BlockCommand *move_distance(double distance) override {
-        double target_distance = distance / (diameter * M_PI);
-        this->motor->move_relative(target_distance, this->speed);
+	EitherBlockCommand(BlockCommand* c1, BlockCommand* c2){
+		this->c1 = c1;
+        this->c2 = c2;
+        this->deadline = std::max(c1->deadline, c2->deadline);
+	}
+};
 
-        return new MotorBlockCommand(this->motor, this->motor->get_position() + target_distance);
-    }
+BlockCommand *either(BlockCommand *c1, BlockCommand *c2){
+    return new EitherBlockCommand(c1, c2);
+}
 
-    virtual void set_speed(double speed) override {
-        this->speed = speed;
-    }
+BlockCommand *both(BlockCommand *c1, BlockCommand *c2){
+    return new MultiBlockCommand(c1, c2);
+}
 
-    WheelMotorSystem(pros::Motor *motor, double diameter, double speed = 100) {
-        this->motor = motor;
-        this->diameter = diameter;
-        this->speed = speed;
-    }
-};
+// The drive and rollers are composed from the templates in
+// motor_templates.h, so their ports are fixed at compile time
+typedef Wheel<PortMotor<ROBOT_CONFIG.left_drive.port>> LeftDriveWheel;
+typedef Wheel<PortMotor<ROBOT_CONFIG.right_drive.port>> RightDriveWheel;
+typedef WheelPair<LeftDriveWheel, RightDriveWheel> StraightDrive;
+typedef WheelPair<
+    Wheel<PortMotor<ROBOT_CONFIG.left_roller.port>>,
+    Wheel<PortMotor<ROBOT_CONFIG.right_roller.port>>
+> Rollers;
+
+// Turns in place by driving the wheels in opposite directions. Angle is
+// positive for clockwise, negative for counter-clockwise. The wheels drive
+// around a circle with the inter wheel distance as diameter.
+template<typename Drive>
+BlockCommand *turn_wheels(Drive *drive, okapi::QLength inter_wheel_distance, okapi::QAngle angle){
+    okapi::QLength distance = arc_length(angle, inter_wheel_distance);
+
+    return new MultiBlockCommand(
+        drive->left.move_distance(distance),
+        drive->right.move_distance(-1 * distance)
+    );
+}
 
-class TurnDriveMotorSystem: public AngularMotorSystem {
+// The wheels scrub through a turn, so an encoder turn lands short of the
+// angle asked for. Once each wheel move finishes, the heading error is
+// measured and turned out again, until it is small enough.
+const double HEADING_TOLERANCE = 1; // degrees
+const int HEADING_MAX_CORRECTIONS = 3;
+
+template<typename Drive>
+class HeadingTurnBlockCommand: public BlockCommand {
 private:
-    LinearMotorSystem *left_drive, *right_drive;
-    double inter_wheel_distance; // in inches
+    Drive *drive;
+    okapi::QLength inter_wheel_distance;
+    HeadingEstimator *heading;
+    okapi::QAngle target;
+    BlockCommand *move;
+    int corrections;
 
 public:
-    void move_velocity(double velocity) override {
-        this->left_drive->move_velocity(velocity);
-        this->right_drive->move_velocity(-velocity);
-    }
-
-    void set_speed(double speed) override {
-        this->left_drive->set_speed(speed);
-        this->right_drive->set_speed(speed);
-    }
+    virtual bool check() override {
+        if(!this->move->check()){
+            return false;
+        }
 
-    BlockCommand *move_angle(double angle) override {
-        // Angle should be in rotations positive for clockwise, negative for counter-clockwise
+        okapi::QAngle error = this->target - this->heading->get_heading();
+        if(fabs(error.convert(okapi::degree)) < HEADING_TOLERANCE || this->corrections >= HEADING_MAX_CORRECTIONS){
+            return true;
+        }
 
-        return new MultiBlockCommand(
-            this->left_drive->move_distance(this->inter_wheel_distance * M_PI * angle),
-            this->right_drive->move_distance(-this->inter_wheel_distance * M_PI * angle)
-        );
+        this->move = turn_wheels(this->drive, this->inter_wheel_distance, error);
+        this->corrections++;
+        return false;
     }
 
-    TurnDriveMotorSystem(LinearMotorSystem *left_drive, LinearMotorSystem *right_drive, double inter_wheel_distance){
-        this->left_drive = left_drive;
-        this->right_drive = right_drive;
+    HeadingTurnBlockCommand(Drive *drive, okapi::QLength inter_wheel_distance,
+            HeadingEstimator *heading, okapi::QAngle angle){
+        this->drive = drive;
         this->inter_wheel_distance = inter_wheel_distance;
+        this->heading = heading;
+        this->target = heading->get_heading() + angle;
+        this->move = turn_wheels(drive, inter_wheel_distance, angle);
+        this->corrections = 0;
     }
 };
 
-class StraightDriveMotorSystem: public LinearMotorSystem {
+template<typename Drive>
+class TurnDrive {
 private:
-    LinearMotorSystem *left_drive, *right_drive;
+    Drive *drive;
+    okapi::QLength inter_wheel_distance;
+    HeadingEstimator *heading;
 
 public:
-    void move_velocity(double velocity) override {
-        this->left_drive->move_velocity(velocity);
-        this->right_drive->move_velocity(velocity);
+    void move_velocity(okapi::QAngularSpeed velocity){
+        this->drive->left.move_velocity(velocity);
+        this->drive->right.move_velocity(-velocity);
     }
 
-    BlockCommand *move_distance(double distance) override {
-        return new MultiBlockCommand(
-            this->left_drive->move_distance(distance),
-            this->right_drive->move_distance(distance)
-        );
+    void set_speed(okapi::QAngularSpeed speed){
+        this->drive->set_speed(speed);
     }
 
-    virtual void set_speed(double speed) override {
-        this->left_drive->set_speed(speed);
-        this->right_drive->set_speed(speed);
+    BlockCommand *move_angle(okapi::QAngle angle){
+        return new HeadingTurnBlockCommand<Drive>(this->drive, this->inter_wheel_distance, this->heading, angle);
     }
 
-    StraightDriveMotorSystem(LinearMotorSystem *left_drive, LinearMotorSystem *right_drive){
-        this->left_drive = left_drive;
-        this->right_drive = right_drive;
+    TurnDrive(Drive *drive, okapi::QLength inter_wheel_distance, HeadingEstimator *heading){
+        this->drive = drive;
+        this->inter_wheel_distance = inter_wheel_distance;
+        this->heading = heading;
     }
 };
 
-class RollerMotorSystem: public LinearMotorSystem {
-private:
-    LinearMotorSystem *left_roller, *right_roller;
-    double roller_radius;
+// The tray profile is gain scheduled on the tray angle. Far from vertical the
+// tray can swing as fast as the motor allows, but as the stack approaches
+// vertical it has to slow down or the top cubes tip over. Angles are tray
+// angles (0 is all the way back, 0.25 rotations is vertical) and velocities are
+// motor RPM, since the profile works at the pros::Motor boundary.
+//
+// The profile never runs faster than the tray's set speed either. That
+// defaults to TRAY_DEFAULT_SPEED, the 50 RPM the tray was limited to before it
+// had a profile, so stacking moves stay as gentle as they were tuned and the
+// 100 RPM segments below only apply once a caller raises the speed, as
+// unfold() does for a tray with no cubes on it.
+const okapi::QAngularSpeed TRAY_DEFAULT_SPEED = 50_rpm;
+
+struct TrayGain {
+    double angle; // tray rotations
+    double max_velocity;
+    double approach_gain; // RPM per motor rotation of remaining travel
+};
 
-public:
-    void move_velocity(double velocity) override {
-        this->left_roller->move_velocity(velocity);
-        this->right_roller->move_velocity(velocity);
+const TrayGain TRAY_GAIN_SCHEDULE[] = {
+    {0.00, 100, 80},
+    {0.12, 100, 80},
+    {0.18, 70, 60},
+    {0.22, 40, 45},
+    {0.25, 20, 35},
+};
+const int TRAY_GAIN_SCHEDULE_SIZE = sizeof(TRAY_GAIN_SCHEDULE) / sizeof(TrayGain);
+
+// A heavy stack draws more current while the tray lifts it. The measured load
+// scales down the scheduled velocity so a full stack is set down more gently
+// than a couple of cubes.
+const double TRAY_UNLOADED_CURRENT = 400; // mA
+const double TRAY_FULL_LOAD_CURRENT = 2000; // mA above unloaded
+const double TRAY_LOAD_DERATE = 0.4;
+const double TRAY_CURRENT_SMOOTHING = 0.2;
+
+const double TRAY_MIN_VELOCITY = 5; // RPM
+const double TRAY_ACCELERATION = 25; // RPM per profile tick
+const double TRAY_TARGET_SIZE = 0.015; // motor rotations
+const int TRAY_PROFILE_PERIOD = 10; // ms
+
+TrayGain tray_gain_at(double angle){
+    if(angle <= TRAY_GAIN_SCHEDULE[0].angle){
+        return TRAY_GAIN_SCHEDULE[0];
+    }
+
+    for(int i = 1; i < TRAY_GAIN_SCHEDULE_SIZE; i++){
+        const TrayGain &low = TRAY_GAIN_SCHEDULE[i - 1];
+        const TrayGain &high = TRAY_GAIN_SCHEDULE[i];
+
+        if(angle < high.angle){
+            double t = (angle - low.angle) / (high.angle - low.angle);
+            return {
+                angle,
+                low.max_velocity + (high.max_velocity - low.max_velocity) * t,
+                low.approach_gain + (high.approach_gain - low.approach_gain) * t
+            };
+        }
     }
 
-    BlockCommand *move_distance(double distance) override {
-        return new MultiBlockCommand(
-            this->left_roller->move_distance(distance),
-            this->right_roller->move_distance(distance)
-        );
-    }
+    return TRAY_GAIN_SCHEDULE[TRAY_GAIN_SCHEDULE_SIZE - 1];
+}
+
+// One step of the profile, in motor rotations and RPM. The load is 0 for an
+// empty tray and 1 for a full stack.
+double tray_profile_velocity(double position, double target, double speed, double load, double last_velocity){
+    double error = target - position;
+    TrayGain gain = tray_gain_at(to_rotations(TrayGearRatio::mechanism_angle(position)));
+
+    double max_velocity = std::min(gain.max_velocity, speed) * (1 - TRAY_LOAD_DERATE * load);
+    double velocity = std::min(max_velocity, gain.approach_gain * fabs(error));
+    velocity = std::max(velocity, TRAY_MIN_VELOCITY);
+
+    // Ramp up from the last command so the stack isn't jerked at the start
+    velocity = std::min(velocity, fabs(last_velocity) + TRAY_ACCELERATION);
+
+    return error > 0 ? velocity : -velocity;
+}
 
-    virtual void set_speed(double speed) override {
-        this->left_roller->set_speed(speed);
-        this->right_roller->set_speed(speed);
+// Longest the profile could be expected to take
+const double TRAY_PROFILE_MAX_TIME = 30000; // ms
+
+// How long the profile takes with a full stack, found by stepping the same
+// velocity law the profile task runs as if the motor followed it exactly
+double tray_profile_time(double position, double target, double speed){
+    double velocity = 0;
+    double time = 0;
+    while(fabs(target - position) >= TRAY_TARGET_SIZE && time < TRAY_PROFILE_MAX_TIME){
+        velocity = tray_profile_velocity(position, target, speed, 1, velocity);
+        position += velocity / 60 * TRAY_PROFILE_PERIOD / 1000;
+        time += TRAY_PROFILE_PERIOD;
     }
+    return time;
+}
+
+class TrayMotorSystem;
+
+class TrayProfileBlockCommand: public BlockCommand {
+private:
+    TrayMotorSystem *tray;
+
+public:
+    virtual bool check() override;
 
-    RollerMotorSystem(pros::Motor *left_motor, pros::Motor *right_motor, double roller_radius) {
-        this->left_roller = new WheelMotorSystem(left_motor, roller_radius * 2);
-        this->right_roller = new WheelMotorSystem(right_motor, roller_radius * 2);
-        this->roller_radius = roller_radius;
+    TrayProfileBlockCommand(TrayMotorSystem *tray){
+        this->tray = tray;
     }
 };
 
-class TrayMotorSystem: public AbsoluteAngularMotorSystem {
+class TrayMotorSystem final: public AbsoluteAngularMotorSystem {
 private:
     pros::Motor *motor;
-    double speed;
+    okapi::QAngularSpeed speed;
+
+    // Profile state shared with the profile task. The mutex keeps a manual
+    // move_velocity from being overwritten by a profile tick in flight.
+    pros::Mutex profile_mutex;
+    pros::Task *profile_task;
+    volatile bool profile_active;
+    double profile_target; // motor rotations
+    double profile_velocity; // last commanded RPM
+    double filtered_current; // mA
+
+    static void profile_task_fn(void *param){
+        ((TrayMotorSystem*) param)->profile_loop();
+    }
+
+    void profile_loop(){
+        ProfiledLoop loop("Tray profile", TRAY_PROFILE_PERIOD);
+
+        while(true){
+            // A failed read is PROS_ERR, which is INT32_MAX and would swamp
+            // the average, so it is skipped
+            std::int32_t current = this->motor->get_current_draw();
+            if(current != PROS_ERR){
+                this->filtered_current += TRAY_CURRENT_SMOOTHING * (current - this->filtered_current);
+            }
+
+            this->profile_mutex.take(TIMEOUT_MAX);
+            if(this->profile_active){
+                this->profile_step();
+            }
+            this->profile_mutex.give();
+
+            loop.wait();
+        }
+    }
+
+    void profile_step(){
+        double position = this->motor->get_position();
+        double error = this->profile_target - position;
+
+        if(fabs(error) < TRAY_TARGET_SIZE){
+            // Let the motor firmware hold the final position
+            this->motor->move_absolute(this->profile_target, TRAY_MIN_VELOCITY);
+            this->profile_velocity = 0;
+            this->profile_active = false;
+            return;
+        }
+
+        double load = (this->filtered_current - TRAY_UNLOADED_CURRENT) / TRAY_FULL_LOAD_CURRENT;
+        load = std::min(std::max(load, 0.0), 1.0);
+
+        this->profile_velocity = tray_profile_velocity(position, this->profile_target, to_rpm(this->speed),
+            load, this->profile_velocity);
+        this->motor->move_velocity(this->profile_velocity);
+    }
+
+    BlockCommand *start_profile(double target){
+        this->profile_mutex.take(TIMEOUT_MAX);
+        this->profile_target = target;
+        this->profile_velocity = this->motor->get_actual_velocity();
+        this->profile_active = true;
+        this->profile_mutex.give();
+
+        BlockCommand *command = new TrayProfileBlockCommand(this);
+        command->deadline = command_deadline(tray_profile_time(this->motor->get_position(), target, to_rpm(this->speed)));
+        return command;
+    }
+
+    void stop_profile(){
+        this->profile_active = false;
+    }
 
 public:
-    virtual void move_velocity(double velocity) override {
-        this->motor->move_velocity(velocity);
+    virtual void move_velocity(okapi::QAngularSpeed velocity) override {
+        this->profile_mutex.take(TIMEOUT_MAX);
+        this->stop_profile();
+        this->motor->move_velocity(to_rpm(velocity));
+        this->profile_mutex.give();
     }
 
-    virtual void set_speed(double speed) override {
-        // Should not excede 50 rpm
+    virtual void set_speed(okapi::QAngularSpeed speed) override {
+        // Caps the profile velocity, should not excede 100 rpm
         this->speed = speed;
     }
 
-    virtual BlockCommand *move_angle(double angle) override {
-        double target_angle = angle * 7;
-        this->motor->move_relative(target_angle, this->speed);
+    virtual BlockCommand *move_angle(okapi::QAngle angle) override {
+        return this->start_profile(this->motor->get_position() + TrayGearRatio::motor_rotations(angle));
+    }
 
-        return new MotorBlockCommand(this->motor, this->motor->get_position() + target_angle);
+    virtual BlockCommand *move_to_angle(okapi::QAngle angle) override {
+        return this->start_profile(TrayGearRatio::motor_rotations(angle));
     }
 
-    virtual BlockCommand *move_to_angle(double angle) override {
-        double target_angle = angle * 7;
-        this->motor->move_absolute(target_angle, this->speed);
+    virtual okapi::QAngle get_angle() override {
+        return TrayGearRatio::mechanism_angle(this->motor->get_position());
+    }
 
-        return new MotorBlockCommand(this->motor, target_angle);
+    bool is_profile_active(){
+        return this->profile_active;
     }
 
     TrayMotorSystem(pros::Motor *motor){
         this->motor = motor;
-        this->speed = 50;
+        this->speed = TRAY_DEFAULT_SPEED;
+        this->profile_active = false;
+        this->profile_target = 0;
+        this->profile_velocity = 0;
+        this->filtered_current = 0;
+        this->profile_task = new pros::Task(profile_task_fn, this, TASK_PRIORITY_DEFAULT + 1,
+            TASK_STACK_DEPTH_DEFAULT, "Tray profile");
     }
 };
 
-class ArmMotorSystem: public AbsoluteAngularMotorSystem {
+bool TrayProfileBlockCommand::check(){
+    return !this->tray->is_profile_active();
+}
+
+class ArmMotorSystem final: public AbsoluteAngularMotorSystem {
 private:
     pros::Motor *left_motor, *right_motor;
-    double speed;
+    okapi::QAngularSpeed speed;
 
 public:
-    void move_velocity(double velocity) override {
-        this->left_motor->move_velocity(velocity);
-        this->right_motor->move_velocity(velocity);
+    void move_velocity(okapi::QAngularSpeed velocity) override {
+        this->left_motor->move_velocity(to_rpm(velocity));
+        this->right_motor->move_velocity(to_rpm(velocity));
     }
 
-    BlockCommand *move_angle(double angle) override {
-        double target_angle = angle * 7;
+    BlockCommand *move_angle(okapi::QAngle angle) override {
+        double target_angle = ArmGearRatio::motor_rotations(angle);
 
-        this->left_motor->move_relative(target_angle, this->speed);
-        this->right_motor->move_relative(target_angle, this->speed);
+        this->left_motor->move_relative(target_angle, to_rpm(this->speed));
+        this->right_motor->move_relative(target_angle, to_rpm(this->speed));
 
         return new MultiBlockCommand(
             new MotorBlockCommand(this->left_motor, this->left_motor->get_position() + target_angle),
@@ -247,15 +468,15 @@ public:
         );
     }
 
-    virtual void set_speed(double speed) override {
+    virtual void set_speed(okapi::QAngularSpeed speed) override {
         this->speed = speed;
     }
 
-    virtual BlockCommand *move_to_angle(double angle) override {
-        double target_angle = angle * 7;
+    virtual BlockCommand *move_to_angle(okapi::QAngle angle) override {
+        double target_angle = ArmGearRatio::motor_rotations(angle);
 
-        this->left_motor->move_absolute(target_angle, this->speed);
-        this->right_motor->move_absolute(target_angle, this->speed);
+        this->left_motor->move_absolute(target_angle, to_rpm(this->speed));
+        this->right_motor->move_absolute(target_angle, to_rpm(this->speed));
 
         return new MultiBlockCommand(
             new MotorBlockCommand(this->left_motor, target_angle),
@@ -263,6 +484,10 @@ public:
         );
     }
 
+    virtual okapi::QAngle get_angle() override {
+        return ArmGearRatio::mechanism_angle((this->left_motor->get_position() + this->right_motor->get_position()) / 2);
+    }
+
     virtual void recenter() override {
         double left_motor_pos = this->left_motor->get_position();
         double right_motor_pos = this->right_motor->get_position();
@@ -281,38 +506,118 @@ public:
     ArmMotorSystem(pros::Motor *left_motor, pros::Motor *right_motor){
         this->left_motor = left_motor;
         this->right_motor = right_motor;
-        this->speed = 75;
+        this->speed = 75_rpm;
     }
 };
 
-class StackSetdownSystem: public LinearMotorSystem {
+// While backing away from a stack the rollers have to push the bottom cube out
+// at the same speed the ground moves under it, otherwise the stack is dragged
+// and tips. The drive and rollers use different wheels and gearsets, so instead
+// of commanding both with the same RPM, the roller surface speed is matched to
+// the measured drive surface speed every tick.
+const double SETDOWN_MATCH_GAIN = 0.5;
+
+template<typename Drive, typename Roller>
+class StackSetdown {
 private:
-    LinearMotorSystem *roller, *drive;
+    Drive *drive;
+    Roller *roller;
+    okapi::QAngularSpeed speed;
+
+    // Drive speed that the rollers can still keep up with
+    okapi::QAngularSpeed max_drive_velocity(){
+        return this->get_max_linear_velocity() / this->drive->get_max_linear_velocity() * this->drive->get_max_velocity();
+    }
 
 public:
-    void move_velocity(double velocity) override {
-        this->drive->move_velocity(-velocity);
-        this->roller->move_velocity(velocity);
+    // Matches the roller surface velocity to the measured drive velocity. This
+    // should be called every tick while the drive is moving.
+    void match_velocity(){
+        okapi::QSpeed ground_velocity = -this->drive->get_linear_velocity();
+        okapi::QSpeed roller_velocity = this->roller->get_linear_velocity();
+
+        this->roller->move_linear_velocity(ground_velocity + SETDOWN_MATCH_GAIN * (ground_velocity - roller_velocity));
     }
 
-    BlockCommand *move_distance(double distance) override {
-        return new MultiBlockCommand(
-            this->drive->move_distance(-distance),
-            this->roller->move_distance(distance)
-        );
+    void move_velocity(okapi::QAngularSpeed velocity){
+        okapi::QAngularSpeed max_velocity = this->max_drive_velocity();
+        velocity = std::min(std::max(velocity, -max_velocity), max_velocity);
+
+        this->drive->move_velocity(-velocity);
+        this->match_velocity();
     }
 
-    virtual void set_speed(double speed) override {
+    BlockCommand *move_distance(okapi::QLength distance);
+
+    void set_speed(okapi::QAngularSpeed speed){
+        // The rollers are matched to the drive, so only the drive speed is set
+        this->speed = speed;
         this->drive->set_speed(speed);
-        this->roller->set_speed(speed);
     }
 
-    StackSetdownSystem(LinearMotorSystem* drive, LinearMotorSystem* roller){
+    okapi::QLength get_distance(){
+        return -this->drive->get_distance();
+    }
+
+    okapi::QSpeed get_linear_velocity(){
+        return -this->drive->get_linear_velocity();
+    }
+
+    okapi::QAngularSpeed get_max_velocity(){
+        return this->max_drive_velocity();
+    }
+
+    okapi::QSpeed get_max_linear_velocity(){
+        return std::min(this->drive->get_max_linear_velocity(), this->roller->get_max_linear_velocity());
+    }
+
+    void move_linear_velocity(okapi::QSpeed velocity){
+        okapi::QSpeed max_velocity = this->get_max_linear_velocity();
+        velocity = std::min(std::max(velocity, -max_velocity), max_velocity);
+
+        this->drive->move_linear_velocity(-velocity);
+        this->match_velocity();
+    }
+
+    StackSetdown(Drive *drive, Roller *roller){
         this->drive = drive;
         this->roller = roller;
+        this->speed = 100_rpm;
+    }
+};
+
+template<typename Drive, typename Roller>
+class SetdownBlockCommand: public BlockCommand {
+private:
+    StackSetdown<Drive, Roller> *setdown;
+    BlockCommand *drive_command;
+    Roller *roller;
+
+public:
+    virtual bool check() override {
+        if(this->drive_command->check()){
+            this->roller->move_velocity(0_rpm);
+            return true;
+        }
+
+        this->setdown->match_velocity();
+        return false;
+    }
+
+    SetdownBlockCommand(StackSetdown<Drive, Roller> *setdown, BlockCommand *drive_command, Roller *roller){
+        this->setdown = setdown;
+        this->drive_command = drive_command;
+        this->roller = roller;
+        this->deadline = drive_command->deadline;
     }
 };
 
+template<typename Drive, typename Roller>
+BlockCommand *StackSetdown<Drive, Roller>::move_distance(okapi::QLength distance){
+    this->drive->set_speed(std::min(this->speed, this->max_drive_velocity()));
+    return new SetdownBlockCommand<Drive, Roller>(this, this->drive->move_distance(-distance), this->roller);
+}
+
 void RobotDeviceInterfaces::activate_brakes() {
     std::cout << "Activated brakes\n";
     this->left_drive_motor->set_brake_mode(MOTOR_BRAKE_BRAKE);
@@ -331,43 +636,234 @@ void RobotDeviceInterfaces::deactivate_brakes() {
     this->tray_motor->set_brake_mode(MOTOR_BRAKE_COAST);
 }
 
+void RobotDeviceInterfaces::sample_telemetry(RobotTelemetry *sample) {
+    sample->time = pros::millis();
+    sample->left_drive_velocity = this->left_drive_motor->get_actual_velocity();
+    sample->right_drive_velocity = this->right_drive_motor->get_actual_velocity();
+    sample->arm_skew = this->left_arm_motor->get_position() - this->right_arm_motor->get_position();
+    sample->tray_angle = to_rotations(TrayGearRatio::mechanism_angle(this->tray_motor->get_position()));
+
+    pros::Motor *motors[TELEMETRY_MOTOR_COUNT] = {
+        this->left_drive_motor, this->right_drive_motor,
+        this->left_arm_motor, this->right_arm_motor,
+        this->tray_motor,
+        this->left_roller_motor, this->right_roller_motor,
+    };
+    for(int i = 0; i < TELEMETRY_MOTOR_COUNT; i++){
+        sample->motor_temperatures[i] = motors[i]->get_temperature();
+    }
+}
+
+std::vector<pros::Motor*> RobotDeviceInterfaces::get_arm_motors() {
+    return {this->left_arm_motor, this->right_arm_motor};
+}
+
+std::vector<pros::Motor*> RobotDeviceInterfaces::get_tray_motors() {
+    return {this->tray_motor};
+}
+
+std::vector<pros::Motor*> RobotDeviceInterfaces::get_motors() {
+    return {
+        this->left_drive_motor, this->right_drive_motor,
+        this->left_arm_motor, this->right_arm_motor,
+        this->tray_motor,
+        this->left_roller_motor, this->right_roller_motor
+    };
+}
+
+pros::Motor make_motor(const MotorConfig &config){
+    return pros::Motor(config.port, config.gearset, config.reversed, MOTOR_ENCODER_ROTATIONS);
+}
+
+// The motors and motor systems are statically allocated from ROBOT_CONFIG. The
+// implementation classes hold each other by their concrete types, and the drive
+// and rollers call their motor ports directly, so only the interface pointers
+// handed out to autonomous and opcontrol go through virtual dispatch.
 RobotDeviceInterfaces::RobotDeviceInterfaces() {
-    this->left_drive_motor = new pros::Motor(11, MOTOR_GEARSET_18, false, MOTOR_ENCODER_ROTATIONS);
-    this->right_drive_motor = new pros::Motor(20, MOTOR_GEARSET_18, true, MOTOR_ENCODER_ROTATIONS);
-
-    this->left_arm_motor = new pros::Motor(3, MOTOR_GEARSET_36, false, MOTOR_ENCODER_ROTATIONS);
-    this->right_arm_motor = new pros::Motor(10, MOTOR_GEARSET_36, true, MOTOR_ENCODER_ROTATIONS);
-    this->tray_motor = new pros::Motor(19, MOTOR_GEARSET_36, true, MOTOR_ENCODER_ROTATIONS);
-    this->left_roller_motor = new pros::Motor(2, MOTOR_GEARSET_36, true, MOTOR_ENCODER_ROTATIONS);
-    this->right_roller_motor = new pros::Motor(9, MOTOR_GEARSET_36, false, MOTOR_ENCODER_ROTATIONS);
-
-    this->left_drive = new WheelMotorSystem(this->left_drive_motor, 3.25);
-    this->right_drive = new WheelMotorSystem(this->right_drive_motor, 3.25);
-    this->straight_drive = new StraightDriveMotorSystem(this->left_drive, this->right_drive);
-    this->turn_drive = new TurnDriveMotorSystem(this->left_drive, this->right_drive, 10.125);
-
-    this->roller = new RollerMotorSystem(this->left_roller_motor, this->right_roller_motor, 1.5);
-    this->tray = new TrayMotorSystem(this->tray_motor);
-    this->arm = new ArmMotorSystem(this->left_arm_motor, this->right_arm_motor);
-    this->stack_setdown = new StackSetdownSystem(this->straight_drive, this->roller);
+    const RobotConfig &c = ROBOT_CONFIG;
+
+    static pros::Motor left_drive_motor = make_motor(c.left_drive);
+    static pros::Motor right_drive_motor = make_motor(c.right_drive);
+    static pros::Motor left_arm_motor = make_motor(c.left_arm);
+    static pros::Motor right_arm_motor = make_motor(c.right_arm);
+    static pros::Motor tray_motor = make_motor(c.tray);
+    static pros::Motor left_roller_motor = make_motor(c.left_roller);
+    static pros::Motor right_roller_motor = make_motor(c.right_roller);
+
+    // Wheel sizes come from the calibration, which starts as the sizes in
+    // ROBOT_CONFIG
+    okapi::QLength wheel_diameter = calibration.wheel_diameter * okapi::inch;
+    okapi::QLength inter_wheel_distance = calibration.inter_wheel_distance * okapi::inch;
+    okapi::QLength roller_radius = calibration.roller_radius * okapi::inch;
+
+    static StraightDrive drive(wheel_diameter);
+
+    static GyroYawSensor *gyro = c.gyro.port != 0 ? new GyroYawSensor(c.gyro.port, c.gyro.reversed) : NULL;
+    static LinearAdapter<LeftDriveWheel> left_drive(&drive.left);
+    static LinearAdapter<RightDriveWheel> right_drive(&drive.right);
+    static LinearAdapter<StraightDrive> straight_drive(&drive);
+    static HeadingEstimator heading(&left_drive, &right_drive, inter_wheel_distance, gyro);
+    static TurnDrive<StraightDrive> turn(&drive, inter_wheel_distance, &heading);
+    static AngularAdapter<TurnDrive<StraightDrive>> turn_drive(&turn);
+
+    static Rollers rollers(roller_radius * 2);
+    static LinearAdapter<Rollers> roller(&rollers);
+    static TrayMotorSystem tray(&tray_motor);
+    static ArmMotorSystem arm(&left_arm_motor, &right_arm_motor);
+    static StackSetdown<StraightDrive, Rollers> setdown(&drive, &rollers);
+    static LinearAdapter<StackSetdown<StraightDrive, Rollers>> stack_setdown(&setdown);
+
+    static IntakeMonitor intake(&left_roller_motor, &right_roller_motor);
+
+    if(c.vision_port != 0){
+        static VisionFrameSource frames(c.vision_port);
+        static CubeTracker tracker(&frames);
+        tracker.start();
+        this->vision = &tracker;
+    } else {
+        this->vision = NULL;
+    }
+
+    if(c.ultrasonic_echo != 0){
+        static UltrasonicDistanceSensor wall(c.ultrasonic_ping, c.ultrasonic_echo);
+        this->wall = &wall;
+    } else {
+        this->wall = NULL;
+    }
+
+    static PowerManager power;
+    power.add_motor(&left_drive_motor, POWER_DRIVE);
+    power.add_motor(&right_drive_motor, POWER_DRIVE);
+    power.add_motor(&left_arm_motor, POWER_ARM);
+    power.add_motor(&right_arm_motor, POWER_ARM);
+    power.add_motor(&tray_motor, POWER_TRAY);
+    power.add_motor(&left_roller_motor, POWER_ROLLER);
+    power.add_motor(&right_roller_motor, POWER_ROLLER);
+    power.set_tray(&tray_motor, []{ return tray.is_profile_active(); });
+    power.start();
+
+    this->left_drive_motor = &left_drive_motor;
+    this->right_drive_motor = &right_drive_motor;
+    this->left_arm_motor = &left_arm_motor;
+    this->right_arm_motor = &right_arm_motor;
+    this->tray_motor = &tray_motor;
+    this->left_roller_motor = &left_roller_motor;
+    this->right_roller_motor = &right_roller_motor;
+
+    this->left_drive = &left_drive;
+    this->right_drive = &right_drive;
+    this->straight_drive = &straight_drive;
+    this->turn_drive = &turn_drive;
+
+    this->roller = &roller;
+    this->tray = &tray;
+    this->arm = &arm;
+    this->stack_setdown = &stack_setdown;
+
+    this->intake = &intake;
+    this->power = &power;
+    this->heading = &heading;
+}
+
+// The simulated robot runs the same implementation classes, with the motor
+// templates built on SimulatorPort instead of PortMotor
+typedef Wheel<SimulatorPort<SIM_LEFT_DRIVE>> SimulatedLeftWheel;
+typedef Wheel<SimulatorPort<SIM_RIGHT_DRIVE>> SimulatedRightWheel;
+typedef WheelPair<SimulatedLeftWheel, SimulatedRightWheel> SimulatedDrive;
+typedef WheelPair<
+    Wheel<SimulatorPort<SIM_LEFT_ROLLER>>,
+    Wheel<SimulatorPort<SIM_RIGHT_ROLLER>>
+> SimulatedRollers;
+
+RobotDeviceInterfaces::RobotDeviceInterfaces(Simulator *simulator) {
+    simulator->start();
+
+    // The simulator models the robot as built in ROBOT_CONFIG, and the robot
+    // code sees it through the calibration like the real one
+    okapi::QLength wheel_diameter = calibration.wheel_diameter * okapi::inch;
+    okapi::QLength inter_wheel_distance = calibration.inter_wheel_distance * okapi::inch;
+    okapi::QLength roller_radius = calibration.roller_radius * okapi::inch;
+
+    static SimulatedDrive drive(wheel_diameter);
+
+    static SimulatedGyro gyro([simulator]{ return simulator->get_pose().heading; });
+    static LinearAdapter<SimulatedLeftWheel> left_drive(&drive.left);
+    static LinearAdapter<SimulatedRightWheel> right_drive(&drive.right);
+    static LinearAdapter<SimulatedDrive> straight_drive(&drive);
+    static HeadingEstimator heading(&left_drive, &right_drive, inter_wheel_distance, &gyro);
+    static TurnDrive<SimulatedDrive> turn(&drive, inter_wheel_distance, &heading);
+    static AngularAdapter<TurnDrive<SimulatedDrive>> turn_drive(&turn);
+
+    static SimulatedRollers rollers(roller_radius * 2);
+    static LinearAdapter<SimulatedRollers> roller(&rollers);
+    static TrayMotorSystem tray(simulator->get_motor(SIM_TRAY));
+    static ArmMotorSystem arm(simulator->get_motor(SIM_LEFT_ARM), simulator->get_motor(SIM_RIGHT_ARM));
+    static StackSetdown<SimulatedDrive, SimulatedRollers> setdown(&drive, &rollers);
+    static LinearAdapter<StackSetdown<SimulatedDrive, SimulatedRollers>> stack_setdown(&setdown);
+
+    static IntakeMonitor intake(simulator->get_motor(SIM_LEFT_ROLLER), simulator->get_motor(SIM_RIGHT_ROLLER));
+
+    static SimulatedUltrasonic wall([simulator]{ return simulator->get_wall_distance(); });
+    this->wall = &wall;
+    this->vision = NULL;
+
+    static PowerManager power;
+    power.add_motor(simulator->get_motor(SIM_LEFT_DRIVE), POWER_DRIVE);
+    power.add_motor(simulator->get_motor(SIM_RIGHT_DRIVE), POWER_DRIVE);
+    power.add_motor(simulator->get_motor(SIM_LEFT_ARM), POWER_ARM);
+    power.add_motor(simulator->get_motor(SIM_RIGHT_ARM), POWER_ARM);
+    power.add_motor(simulator->get_motor(SIM_TRAY), POWER_TRAY);
+    power.add_motor(simulator->get_motor(SIM_LEFT_ROLLER), POWER_ROLLER);
+    power.add_motor(simulator->get_motor(SIM_RIGHT_ROLLER), POWER_ROLLER);
+    power.set_tray(simulator->get_motor(SIM_TRAY), []{ return tray.is_profile_active(); });
+    power.start();
+
+    this->left_drive_motor = simulator->get_motor(SIM_LEFT_DRIVE);
+    this->right_drive_motor = simulator->get_motor(SIM_RIGHT_DRIVE);
+    this->left_arm_motor = simulator->get_motor(SIM_LEFT_ARM);
+    this->right_arm_motor = simulator->get_motor(SIM_RIGHT_ARM);
+    this->tray_motor = simulator->get_motor(SIM_TRAY);
+    this->left_roller_motor = simulator->get_motor(SIM_LEFT_ROLLER);
+    this->right_roller_motor = simulator->get_motor(SIM_RIGHT_ROLLER);
+
+    this->left_drive = &left_drive;
+    this->right_drive = &right_drive;
+    this->straight_drive = &straight_drive;
+    this->turn_drive = &turn_drive;
+
+    this->roller = &roller;
+    this->tray = &tray;
+    this->arm = &arm;
+    this->stack_setdown = &stack_setdown;
+
+    this->intake = &intake;
+    this->power = &power;
+    this->heading = &heading;
+    this->controller = global_controller;
 }
 
 void unfold(RobotDeviceInterfaces *robot){
-    robot->tray->set_speed(100);
+    robot->tray->set_speed(100_rpm);
 
     // Move the tray forward
-    robot->tray->move_to_angle(0.25)->block();
+    robot->tray->move_to_angle(0.25_rot)->block();
+    if(commands_cancelled()){
+        return;
+    }
 
-    // Start the roller
-    robot->roller->move_velocity(100);
-    pros::delay(250);
+    // Start the roller. It runs at free speed, so the time is battery
+    // compensated.
+    robot->roller->move_velocity(100_rpm);
+    compensated_delay(250);
 
-    // Move the tray back
-    robot->tray->move_to_angle(0.03)->block();
-    robot->tray->set_speed(100);
+    // Move the tray back, unless the unfold was cancelled during the delay
+    if(!commands_cancelled()){
+        robot->tray->move_to_angle(0.03_rot)->block();
+    }
+    robot->tray->set_speed(100_rpm);
 
     // Stop the rollers
-    robot->roller->move_velocity(0);
+    robot->roller->move_velocity(0_rpm);
 
     // Finished unfolding
 }
@@ -0,0 +1,250 @@
+#include "main.h"
+#include "script.h"
+#include <cstdio>
+#include <cstring>
+
+const int SCRIPT_MAX_LINE = 128;
+
+struct ScriptCommandName {
+	const char *name;
+	ScriptOpcode opcode;
+	int arguments;
+};
+
+const ScriptCommandName SCRIPT_COMMANDS[] = {
+	{"drive", OP_DRIVE, 1},
+	{"turn", OP_TURN, 1},
+	{"roller", OP_ROLLER, 1},
+	{"roller_distance", OP_ROLLER_DISTANCE, 1},
+	{"tray", OP_TRAY, 1},
+	{"arm", OP_ARM, 1},
+	{"speed", OP_SPEED, 2},
+	{"wait", OP_WAIT, 1},
+	{"wait_until", OP_WAIT_CUBES, 2},
+	{"parallel", OP_PARALLEL, 0},
+	{"end", OP_END, 0},
+	{"unfold", OP_UNFOLD, 0},
+	{"setdown", OP_SETDOWN, 0},
+};
+
+const char *SCRIPT_SYSTEM_NAMES[] = {"drive", "turn", "roller", "tray", "arm"};
+
+Script::Script(){
+	this->compiled = false;
+}
+
+bool Script::compile_line(const char *line, int line_number){
+	char text[SCRIPT_MAX_LINE];
+	strncpy(text, line, sizeof(text) - 1);
+	text[sizeof(text) - 1] = 0;
+	char *comment = strchr(text, '#');
+	if(comment != NULL){
+		*comment = 0;
+	}
+
+	char command[32] = {0}, first[32] = {0}, second[32] = {0}, extra[32] = {0};
+	int count = sscanf(text, "%31s %31s %31s %31s", command, first, second, extra);
+	if(count <= 0){
+		return true;
+	}
+
+	const ScriptCommandName *match = NULL;
+	for(const ScriptCommandName &entry : SCRIPT_COMMANDS){
+		if(strcmp(entry.name, command) == 0){
+			match = &entry;
+		}
+	}
+	if(match == NULL){
+		std::cout << "Script line " << line_number << ": unknown command " << command << "\n";
+		return false;
+	}
+	if(count - 1 != match->arguments){
+		std::cout << "Script line " << line_number << ": " << command << " takes " << match->arguments << " arguments\n";
+		return false;
+	}
+
+	ScriptInstruction instruction = {match->opcode, SYSTEM_DRIVE, 0};
+	const char *number = first;
+
+	if(match->opcode == OP_SPEED){
+		bool found = false;
+		for(size_t i = 0; i < sizeof(SCRIPT_SYSTEM_NAMES) / sizeof(*SCRIPT_SYSTEM_NAMES); i++){
+			if(strcmp(SCRIPT_SYSTEM_NAMES[i], first) == 0){
+				instruction.system = (ScriptSystem)i;
+				found = true;
+			}
+		}
+		if(!found){
+			std::cout << "Script line " << line_number << ": unknown system " << first << "\n";
+			return false;
+		}
+		number = second;
+	} else if(match->opcode == OP_WAIT_CUBES){
+		if(strcmp(first, "cubes") != 0){
+			std::cout << "Script line " << line_number << ": can only wait until cubes\n";
+			return false;
+		}
+		number = second;
+	}
+
+	if(match->arguments > 0){
+		char *end;
+		instruction.argument = strtof(number, &end);
+		if(number[0] == 0 || *end != 0){
+			std::cout << "Script line " << line_number << ": expected a number\n";
+			return false;
+		}
+	}
+
+	// Waiting no time or for no cubes does nothing, so it must be a typo
+	if((match->opcode == OP_WAIT || match->opcode == OP_WAIT_CUBES) && !(instruction.argument > 0)){
+		std::cout << "Script line " << line_number << ": " << command << " needs a positive number\n";
+		return false;
+	}
+
+	this->instructions.push_back(instruction);
+	return true;
+}
+
+bool Script::compile_file(const char *path){
+	this->instructions.clear();
+	this->compiled = false;
+
+	FILE *file = fopen(path, "r");
+	if(file == NULL){
+		return false;
+	}
+
+	char line[SCRIPT_MAX_LINE];
+	int line_number = 0;
+	bool ok = true;
+	bool in_parallel = false;
+	while(ok && fgets(line, sizeof(line), file) != NULL){
+		line_number++;
+
+		// fgets splits a line that doesn't fit into several, which would
+		// each be compiled. A line without its newline is only complete at
+		// the end of the file.
+		if(strchr(line, '\n') == NULL){
+			int next = fgetc(file);
+			if(next != EOF){
+				std::cout << "Script line " << line_number << ": longer than " << SCRIPT_MAX_LINE - 2 << " characters\n";
+				ok = false;
+				continue;
+			}
+		}
+
+		size_t previous_size = this->instructions.size();
+		ok = this->compile_line(line, line_number);
+		if(!ok || this->instructions.size() == previous_size){
+			continue;
+		}
+
+		// Parallel blocks can't be nested, because the interpreter only keeps
+		// one list of running commands.
+		ScriptOpcode opcode = this->instructions.back().opcode;
+		if(opcode == OP_PARALLEL || opcode == OP_END){
+			if(in_parallel == (opcode == OP_PARALLEL)){
+				std::cout << "Script line " << line_number << ": mismatched parallel/end\n";
+				ok = false;
+			}
+			in_parallel = opcode == OP_PARALLEL;
+		}
+	}
+	fclose(file);
+
+	if(ok && in_parallel){
+		std::cout << "Script: parallel block is never ended\n";
+		ok = false;
+	}
+	if(!ok){
+		this->instructions.clear();
+		return false;
+	}
+
+	this->instructions.shrink_to_fit();
+	this->compiled = true;
+	std::cout << "Compiled script " << path << ": " << this->instructions.size() << " instructions\n";
+	return true;
+}
+
+bool Script::is_compiled(){
+	return this->compiled;
+}
+
+int Script::size(){
+	return this->instructions.size();
+}
+
+void Script::run(RobotDeviceInterfaces *robot){
+	// Commands started inside a parallel block are kept here and waited on at
+	// the end of the block. Outside a block every command is waited on as soon
+	// as it starts.
+	std::vector<BlockCommand*> running;
+	bool in_parallel = false;
+
+	for(const ScriptInstruction &instruction : this->instructions){
+		BlockCommand *command = NULL;
+		okapi::QAngularSpeed speed = instruction.argument * okapi::rpm;
+
+		switch(instruction.opcode){
+		case OP_DRIVE:
+			command = robot->straight_drive->move_distance(instruction.argument * okapi::inch);
+			break;
+		case OP_TURN:
+			command = robot->turn_drive->move_angle(instruction.argument * rotation);
+			break;
+		case OP_ROLLER:
+			robot->roller->move_velocity(speed);
+			break;
+		case OP_ROLLER_DISTANCE:
+			command = robot->roller->move_distance(instruction.argument * okapi::inch);
+			break;
+		case OP_TRAY:
+			command = robot->tray->move_to_angle(instruction.argument * rotation);
+			break;
+		case OP_ARM:
+			command = robot->arm->move_to_angle(instruction.argument * rotation);
+			break;
+		case OP_SPEED:
+			switch(instruction.system){
+			case SYSTEM_DRIVE: robot->straight_drive->set_speed(speed); break;
+			case SYSTEM_TURN: robot->turn_drive->set_speed(speed); break;
+			case SYSTEM_ROLLER: robot->roller->set_speed(speed); break;
+			case SYSTEM_TRAY: robot->tray->set_speed(speed); break;
+			case SYSTEM_ARM: robot->arm->set_speed(speed); break;
+			}
+			break;
+		case OP_WAIT:
+			pros::delay(instruction.argument);
+			break;
+		case OP_WAIT_CUBES:
+			command = robot->intake->wait_for_cubes(instruction.argument);
+			break;
+		case OP_PARALLEL:
+			in_parallel = true;
+			break;
+		case OP_END:
+			for(BlockCommand *c : running){
+				c->block();
+			}
+			running.clear();
+			in_parallel = false;
+			break;
+		case OP_UNFOLD:
+			unfold(robot);
+			break;
+		case OP_SETDOWN:
+			setdown(robot);
+			break;
+		}
+
+		if(command != NULL){
+			if(in_parallel){
+				running.push_back(command);
+			} else {
+				command->block();
+			}
+		}
+	}
+}
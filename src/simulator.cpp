@@ -0,0 +1,599 @@
+#include "main.h"
+#include "simulator.h"
+#include "motor_templates.h"
+#include <algorithm>
+#include <math.h>
+
+const double SIMULATOR_TIMESTEP = 0.001; // s
+const std::uint32_t SIMULATOR_PERIOD = 1; // ms
+
+// A V5 motor stalls at 2.1N*m through the 100RPM cartridge, and the faster
+// cartridges trade that torque for speed. Torque falls off linearly to zero at
+// free speed.
+const double MOTOR_STALL_TORQUE = 2.1; // N*m at 100RPM
+const double MOTOR_STALL_CURRENT = 2500; // mA
+const double MOTOR_TEMPERATURE = 25; // C
+const std::int32_t MOTOR_MAX_VOLTAGE = 12000; // mV
+// Encoder counts per motor rotation through the 100RPM cartridge. Faster
+// cartridges have fewer.
+const double MOTOR_COUNTS = 1800;
+// Below this the motor reports that it is stopped
+const double MOTOR_STOPPED_VELOCITY = 1; // RPM
+
+// Stand-ins for the motor firmware's controllers. The velocity loop asks for
+// full stall torque when the error is half the free speed, and the position
+// loop asks for a velocity in proportion to the distance left to go.
+const double MOTOR_VELOCITY_GAIN = 2; // stall torques per free speed of error
+const double MOTOR_POSITION_GAIN = 400; // RPM per motor rotation of error
+
+// Friction coefficients passed to FlywheelSimulator for every mechanism
+const double MECHANISM_STATIC_FRICTION = 0.01;
+const double MECHANISM_DYNAMIC_FRICTION = 0.01;
+
+const double ROBOT_MASS = 6; // kg
+
+// Wheels on the two sides that turn at different speeds have to skid
+// sideways. The scrub drags the sides back towards the same speed, and the
+// robot turns a little less than the encoders say.
+const double DRIVE_SCRUB_DAMPING = 0.02; // N*m per rad/s of difference
+const double DRIVE_TURN_EFFICIENCY = 0.9;
+
+const double ARM_MASS = 0.8; // kg
+const double ARM_LENGTH = 0.3; // m, to the center of mass
+const double ARM_REST_ANGLE = -0.6; // rad
+const double ARM_TRAVEL = 0.35 * 2 * M_PI; // rad
+
+const double TRAY_MASS = 1.0; // kg
+const double TRAY_LENGTH = 0.2; // m, to the center of mass
+const double TRAY_REST_ANGLE = 0.35; // rad
+const double TRAY_TRAVEL = 0.3 * 2 * M_PI; // rad
+
+// The rollers carry the inertia of their gear train as well as their own
+const double ROLLER_MASS = 1.0; // kg
+
+const double CUBE_MASS = 0.07; // kg
+// Distance from the robot's center to where the rollers meet a cube
+const double ROLLER_REACH = 0.15; // m
+// Load on the rollers while they pull a cube in, and how far they turn to do it
+const double CUBE_CONTACT_TORQUE = 1.5; // N*m
+const double CUBE_INTAKE_ANGLE = 2 * 2 * M_PI; // rad
+
+const double FIELD_SIZE = 3.6576; // m, 12 feet
+// Distance from the robot's center to the ultrasonic at its front
+const double ULTRASONIC_OFFSET = 0.18; // m
+
+Mechanism::Mechanism(double mass, double link_length, double min_angle, double max_angle):
+    okapi::FlywheelSimulator(mass, link_length, MECHANISM_STATIC_FRICTION, MECHANISM_DYNAMIC_FRICTION, SIMULATOR_TIMESTEP) {
+    this->min_angle = min_angle;
+    this->max_angle = max_angle;
+    // The motor models limit their own torque
+    this->setMaxTorque(INFINITY);
+}
+
+double Mechanism::stepImpl(){
+    okapi::FlywheelSimulator::stepImpl();
+
+    if(this->angle < this->min_angle){
+        this->angle = this->min_angle;
+        this->omega = std::max(this->omega, 0.0);
+        this->accel = 0;
+    } else if(this->angle > this->max_angle){
+        this->angle = this->max_angle;
+        this->omega = std::min(this->omega, 0.0);
+        this->accel = 0;
+    }
+    return this->angle;
+}
+
+void Mechanism::reset(double angle){
+    this->angle = angle;
+    this->omega = 0;
+    this->accel = 0;
+}
+
+SimulatedMotor::SimulatedMotor(Simulator *simulator, std::uint8_t port, pros::motor_gearset_e_t gearset,
+        Mechanism *mechanism, double ratio): pros::Motor(port) {
+    this->simulator = simulator;
+    this->mechanism = mechanism;
+    this->ratio = ratio;
+    this->set_gearset(gearset);
+    this->reversed = false;
+    this->current_limit = MOTOR_STALL_CURRENT;
+    this->voltage_limit = MOTOR_MAX_VOLTAGE;
+    this->brake_mode = MOTOR_BRAKE_COAST;
+    this->pos_pid = {};
+    this->vel_pid = {};
+
+    this->mode = MOTOR_MODE_VELOCITY;
+    this->target = 0;
+    this->max_velocity = 0;
+    this->zero = mechanism->getAngle();
+    this->torque = 0;
+}
+
+void SimulatedMotor::set_gearset(pros::motor_gearset_e_t gearset) const {
+    double free_rpm = to_rpm(gearset_max_velocity(gearset));
+    this->gearset = gearset;
+    this->free_speed = free_rpm * 2 * M_PI / 60;
+    this->stall_torque = MOTOR_STALL_TORQUE * 100 / free_rpm;
+}
+
+double SimulatedMotor::direction() const {
+    return this->reversed ? -1 : 1;
+}
+
+double SimulatedMotor::position() const {
+    return this->direction() * (this->mechanism->getAngle() - this->zero) * this->ratio / (2 * M_PI);
+}
+
+double SimulatedMotor::velocity() const {
+    return this->direction() * this->mechanism->getOmega() * this->ratio * 60 / (2 * M_PI);
+}
+
+double SimulatedMotor::voltage() const {
+    // The voltage that gives the last step's torque at this speed
+    double omega = this->velocity() * 2 * M_PI / 60;
+    double voltage = MOTOR_MAX_VOLTAGE * (this->torque / this->stall_torque + omega / this->free_speed);
+    return std::min(std::max(voltage, (double) -MOTOR_MAX_VOLTAGE), (double) MOTOR_MAX_VOLTAGE);
+}
+
+double SimulatedMotor::step_torque(){
+    double omega = this->direction() * this->mechanism->getOmega() * this->ratio;
+    double free_rpm = this->free_speed * 60 / (2 * M_PI);
+    double torque;
+
+    if(this->mode == MOTOR_MODE_VOLTAGE){
+        double voltage = std::min(std::max(this->target, (double) -this->voltage_limit), (double) this->voltage_limit);
+        torque = this->stall_torque * (voltage / MOTOR_MAX_VOLTAGE - omega / this->free_speed);
+    } else {
+        double target_velocity = this->target;
+        if(this->mode == MOTOR_MODE_POSITION){
+            target_velocity = MOTOR_POSITION_GAIN * (this->target - this->position());
+            target_velocity = std::min(std::max(target_velocity, -this->max_velocity), this->max_velocity);
+        }
+        torque = this->stall_torque * MOTOR_VELOCITY_GAIN * (target_velocity - this->velocity()) / free_rpm;
+    }
+
+    // The torque available falls off towards free speed in the direction the
+    // motor is already turning, and is capped by the current limit
+    double direction = torque >= 0 ? 1 : -1;
+    double available = this->stall_torque * (1 - direction * omega / this->free_speed);
+    available = std::min(std::max(available, 0.0), this->stall_torque * this->current_limit / MOTOR_STALL_CURRENT);
+    this->torque = direction * std::min(fabs(torque), available);
+
+    return this->direction() * this->torque * this->ratio;
+}
+
+std::int32_t SimulatedMotor::operator=(std::int32_t voltage) const {
+    return this->move(voltage);
+}
+
+std::int32_t SimulatedMotor::move(std::int32_t voltage) const {
+    return this->move_voltage(voltage * MOTOR_MAX_VOLTAGE / 127);
+}
+
+std::int32_t SimulatedMotor::move_absolute(const double position, const std::int32_t velocity) const {
+    this->simulator->lock();
+    this->mode = MOTOR_MODE_POSITION;
+    this->target = position;
+    this->max_velocity = abs(velocity);
+    this->simulator->unlock();
+    return 1;
+}
+
+std::int32_t SimulatedMotor::move_relative(const double position, const std::int32_t velocity) const {
+    return this->move_absolute(this->position() + position, velocity);
+}
+
+std::int32_t SimulatedMotor::move_velocity(const std::int32_t velocity) const {
+    this->simulator->lock();
+    this->mode = MOTOR_MODE_VELOCITY;
+    this->target = velocity;
+    this->simulator->unlock();
+    return 1;
+}
+
+std::int32_t SimulatedMotor::move_voltage(const std::int32_t voltage) const {
+    this->simulator->lock();
+    this->mode = MOTOR_MODE_VOLTAGE;
+    this->target = voltage;
+    this->simulator->unlock();
+    return 1;
+}
+
+std::int32_t SimulatedMotor::modify_profiled_velocity(const std::int32_t velocity) const {
+    this->simulator->lock();
+    this->max_velocity = abs(velocity);
+    this->simulator->unlock();
+    return 1;
+}
+
+double SimulatedMotor::get_position(void) const {
+    return this->position();
+}
+
+double SimulatedMotor::get_target_position(void) const {
+    return this->mode == MOTOR_MODE_POSITION ? this->target : this->position();
+}
+
+double SimulatedMotor::get_actual_velocity(void) const {
+    return this->velocity();
+}
+
+std::int32_t SimulatedMotor::get_target_velocity(void) const {
+    return this->mode == MOTOR_MODE_VELOCITY ? lround(this->target) : 0;
+}
+
+std::int32_t SimulatedMotor::get_current_draw(void) const {
+    return lround(fabs(this->torque) / this->stall_torque * MOTOR_STALL_CURRENT);
+}
+
+std::int32_t SimulatedMotor::get_direction(void) const {
+    return this->velocity() < 0 ? -1 : 1;
+}
+
+double SimulatedMotor::get_efficiency(void) const {
+    // With torque falling linearly to free speed, the power out over the
+    // power in is the fraction of free speed the motor is turning at
+    return std::min(fabs(this->velocity()) * 2 * M_PI / 60 / this->free_speed, 1.0) * 100;
+}
+
+std::int32_t SimulatedMotor::is_over_current(void) const {
+    return this->get_current_draw() >= this->current_limit ? 1 : 0;
+}
+
+std::int32_t SimulatedMotor::is_stopped(void) const {
+    return fabs(this->velocity()) < MOTOR_STOPPED_VELOCITY ? 1 : 0;
+}
+
+std::int32_t SimulatedMotor::get_zero_position_flag(void) const {
+    return lround(this->get_raw_position(NULL)) == 0 ? 1 : 0;
+}
+
+std::int32_t SimulatedMotor::get_raw_position(std::uint32_t *const timestamp) const {
+    if(timestamp != NULL){
+        *timestamp = pros::millis();
+    }
+    double free_rpm = this->free_speed * 60 / (2 * M_PI);
+    return lround(this->position() * MOTOR_COUNTS * 100 / free_rpm);
+}
+
+std::int32_t SimulatedMotor::is_over_temp(void) const {
+    return 0;
+}
+
+double SimulatedMotor::get_power(void) const {
+    return fabs(this->voltage() / 1000 * this->get_current_draw() / 1000);
+}
+
+double SimulatedMotor::get_temperature(void) const {
+    return MOTOR_TEMPERATURE;
+}
+
+double SimulatedMotor::get_torque(void) const {
+    return fabs(this->torque);
+}
+
+std::int32_t SimulatedMotor::get_voltage(void) const {
+    return lround(this->voltage());
+}
+
+std::uint32_t SimulatedMotor::get_faults(void) const {
+    return 0;
+}
+
+std::uint32_t SimulatedMotor::get_flags(void) const {
+    return 0;
+}
+
+pros::motor_gearset_e_t SimulatedMotor::get_gearing(void) const {
+    return this->gearset;
+}
+
+std::int32_t SimulatedMotor::set_zero_position(const double position) const {
+    this->simulator->lock();
+    this->zero += this->direction() * position * 2 * M_PI / this->ratio;
+    this->simulator->unlock();
+    return 1;
+}
+
+std::int32_t SimulatedMotor::tare_position(void) const {
+    this->simulator->lock();
+    this->zero = this->mechanism->getAngle();
+    this->simulator->unlock();
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_brake_mode(const pros::motor_brake_mode_e_t mode) const {
+    // Every mode holds when commanded to zero velocity, which is all the
+    // robot code relies on
+    this->brake_mode = mode;
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_current_limit(const std::int32_t limit) const {
+    this->current_limit = std::min((double)limit, MOTOR_STALL_CURRENT);
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_encoder_units(const pros::motor_encoder_units_e_t units) const {
+    if(units != MOTOR_ENCODER_ROTATIONS){
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_gearing(const pros::motor_gearset_e_t gearset) const {
+    this->simulator->lock();
+    this->set_gearset(gearset);
+    this->simulator->unlock();
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_pos_pid(const pros::motor_pid_s_t pid) const {
+    this->pos_pid.kf = pid.kf;
+    this->pos_pid.kp = pid.kp;
+    this->pos_pid.ki = pid.ki;
+    this->pos_pid.kd = pid.kd;
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_pos_pid_full(const pros::motor_pid_full_s_t pid) const {
+    // The simulated position loop stands in for the firmware's and keeps its
+    // own gain, so tuned gains are only checked in the simulator, not used
+    this->pos_pid = pid;
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_vel_pid(const pros::motor_pid_s_t pid) const {
+    this->vel_pid.kf = pid.kf;
+    this->vel_pid.kp = pid.kp;
+    this->vel_pid.ki = pid.ki;
+    this->vel_pid.kd = pid.kd;
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_vel_pid_full(const pros::motor_pid_full_s_t pid) const {
+    this->vel_pid = pid;
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_reversed(const bool reverse) const {
+    this->simulator->lock();
+    this->reversed = reverse;
+    this->simulator->unlock();
+    return 1;
+}
+
+std::int32_t SimulatedMotor::set_voltage_limit(const std::int32_t limit) const {
+    this->simulator->lock();
+    this->voltage_limit = std::min(abs(limit), MOTOR_MAX_VOLTAGE);
+    this->simulator->unlock();
+    return 1;
+}
+
+pros::motor_brake_mode_e_t SimulatedMotor::get_brake_mode(void) const {
+    return this->brake_mode;
+}
+
+std::int32_t SimulatedMotor::get_current_limit(void) const {
+    return lround(this->current_limit);
+}
+
+pros::motor_encoder_units_e_t SimulatedMotor::get_encoder_units(void) const {
+    return MOTOR_ENCODER_ROTATIONS;
+}
+
+pros::motor_pid_full_s_t SimulatedMotor::get_pos_pid(void) const {
+    return this->pos_pid;
+}
+
+pros::motor_pid_full_s_t SimulatedMotor::get_vel_pid(void) const {
+    return this->vel_pid;
+}
+
+std::int32_t SimulatedMotor::is_reversed(void) const {
+    return this->reversed ? 1 : 0;
+}
+
+std::int32_t SimulatedMotor::get_voltage_limit(void) const {
+    return this->voltage_limit;
+}
+
+Simulator::Simulator():
+        left_wheel(ROBOT_MASS / 2, ROBOT_CONFIG.wheel_diameter.convert(okapi::meter) / 2, -INFINITY, INFINITY),
+        right_wheel(ROBOT_MASS / 2, ROBOT_CONFIG.wheel_diameter.convert(okapi::meter) / 2, -INFINITY, INFINITY),
+        arm(ARM_MASS, ARM_LENGTH, ARM_REST_ANGLE, ARM_REST_ANGLE + ARM_TRAVEL),
+        tray(TRAY_MASS, TRAY_LENGTH, TRAY_REST_ANGLE, TRAY_REST_ANGLE + TRAY_TRAVEL),
+        rollers(ROLLER_MASS, ROBOT_CONFIG.roller_radius.convert(okapi::meter), -INFINITY, INFINITY) {
+    const RobotConfig &c = ROBOT_CONFIG;
+
+    // Only the arm and tray are lifted against gravity
+    auto no_load = [](double, double, double){ return 0.0; };
+    this->left_wheel.setExternalTorqueFunction(no_load);
+    this->right_wheel.setExternalTorqueFunction(no_load);
+    this->rollers.setExternalTorqueFunction(no_load);
+    this->arm.reset(ARM_REST_ANGLE);
+    this->tray.reset(TRAY_REST_ANGLE);
+
+    double arm_ratio = ArmGearRatio::ratio;
+    double tray_ratio = TrayGearRatio::ratio;
+    this->motors[SIM_LEFT_DRIVE] = new SimulatedMotor(this, c.left_drive.port, c.left_drive.gearset, &this->left_wheel, 1);
+    this->motors[SIM_RIGHT_DRIVE] = new SimulatedMotor(this, c.right_drive.port, c.right_drive.gearset, &this->right_wheel, 1);
+    this->motors[SIM_LEFT_ARM] = new SimulatedMotor(this, c.left_arm.port, c.left_arm.gearset, &this->arm, arm_ratio);
+    this->motors[SIM_RIGHT_ARM] = new SimulatedMotor(this, c.right_arm.port, c.right_arm.gearset, &this->arm, arm_ratio);
+    this->motors[SIM_TRAY] = new SimulatedMotor(this, c.tray.port, c.tray.gearset, &this->tray, tray_ratio);
+    this->motors[SIM_LEFT_ROLLER] = new SimulatedMotor(this, c.left_roller.port, c.left_roller.gearset, &this->rollers, 1);
+    this->motors[SIM_RIGHT_ROLLER] = new SimulatedMotor(this, c.right_roller.port, c.right_roller.gearset, &this->rollers, 1);
+
+    this->x = this->start_x = 0;
+    this->y = this->start_y = 0;
+    this->heading = this->start_heading = 0;
+    this->next_cube = 0;
+    this->cube_in_contact = false;
+    this->contact_roller_angle = 0;
+    this->stacked_cubes = 0;
+    this->task = NULL;
+}
+
+void Simulator::task_fn(void *param){
+    Simulator *simulator = (Simulator*) param;
+    ProfiledLoop loop("Simulator", SIMULATOR_PERIOD);
+
+    while(true){
+        simulator->step();
+        loop.wait();
+    }
+}
+
+void Simulator::start(){
+    if(this->task == NULL){
+        // Above the control tasks, so the model keeps time while they run
+        this->task = new pros::Task(task_fn, this, TASK_PRIORITY_MAX - 1,
+            TASK_STACK_DEPTH_DEFAULT, "Simulator");
+    }
+}
+
+void Simulator::lock(){
+    this->mutex.take(TIMEOUT_MAX);
+}
+
+void Simulator::unlock(){
+    this->mutex.give();
+}
+
+void Simulator::step(){
+    this->lock();
+
+    // Every input comes from the state at the start of the step
+    double scrub = DRIVE_SCRUB_DAMPING * (this->left_wheel.getOmega() - this->right_wheel.getOmega());
+    double left_torque = this->motors[SIM_LEFT_DRIVE]->step_torque() - scrub;
+    double right_torque = this->motors[SIM_RIGHT_DRIVE]->step_torque() + scrub;
+    double arm_torque = this->motors[SIM_LEFT_ARM]->step_torque() + this->motors[SIM_RIGHT_ARM]->step_torque();
+    double tray_torque = this->motors[SIM_TRAY]->step_torque();
+    double roller_torque = this->motors[SIM_LEFT_ROLLER]->step_torque() + this->motors[SIM_RIGHT_ROLLER]->step_torque()
+        + this->step_cube_load();
+
+    this->left_wheel.step(left_torque);
+    this->right_wheel.step(right_torque);
+    this->arm.step(arm_torque);
+    this->tray.step(tray_torque);
+    this->rollers.step(roller_torque);
+    this->step_pose();
+
+    this->unlock();
+}
+
+void Simulator::step_pose(){
+    double radius = ROBOT_CONFIG.wheel_diameter.convert(okapi::meter) / 2;
+    double track = ROBOT_CONFIG.inter_wheel_distance.convert(okapi::meter);
+    double left = this->left_wheel.getOmega() * radius;
+    double right = this->right_wheel.getOmega() * radius;
+
+    double velocity = (left + right) / 2;
+    this->heading += DRIVE_TURN_EFFICIENCY * (left - right) / track * SIMULATOR_TIMESTEP;
+    this->x += velocity * cos(this->heading) * SIMULATOR_TIMESTEP;
+    this->y += velocity * sin(this->heading) * SIMULATOR_TIMESTEP;
+}
+
+// Returns the load the next cube puts on the rollers, and counts it as
+// stacked once the rollers have pulled it in
+double Simulator::step_cube_load(){
+    if(this->next_cube >= (int) this->cubes.size()){
+        return 0;
+    }
+
+    if(!this->cube_in_contact){
+        double travelled = (this->x - this->start_x) * cos(this->start_heading)
+            + (this->y - this->start_y) * sin(this->start_heading);
+        if(travelled + ROLLER_REACH < this->cubes[this->next_cube]){
+            return 0;
+        }
+        this->cube_in_contact = true;
+        this->contact_roller_angle = this->rollers.getAngle();
+    }
+
+    // The rollers intake turning backwards
+    if(this->contact_roller_angle - this->rollers.getAngle() >= CUBE_INTAKE_ANGLE){
+        this->next_cube++;
+        this->cube_in_contact = false;
+        this->stacked_cubes++;
+        this->tray.setMass(TRAY_MASS + this->stacked_cubes * CUBE_MASS);
+        return 0;
+    }
+
+    double omega = this->rollers.getOmega();
+    return omega > 0 ? -CUBE_CONTACT_TORQUE : omega < 0 ? CUBE_CONTACT_TORQUE : 0;
+}
+
+SimulatedMotor *Simulator::get_motor(SimulatedMotorId id){
+    return this->motors[id];
+}
+
+void Simulator::reset(SimulatedPose pose){
+    this->lock();
+    this->x = this->start_x = pose.x.convert(okapi::meter);
+    this->y = this->start_y = pose.y.convert(okapi::meter);
+    this->heading = this->start_heading = pose.heading.convert(okapi::radian);
+
+    this->left_wheel.reset(0);
+    this->right_wheel.reset(0);
+    this->arm.reset(ARM_REST_ANGLE);
+    this->tray.reset(TRAY_REST_ANGLE);
+    this->tray.setMass(TRAY_MASS);
+    this->rollers.reset(0);
+
+    this->cubes.clear();
+    this->next_cube = 0;
+    this->cube_in_contact = false;
+    this->stacked_cubes = 0;
+    this->unlock();
+
+    // The motors lock the simulator themselves
+    for(SimulatedMotor *motor: this->motors){
+        motor->move_velocity(0);
+        motor->tare_position();
+    }
+}
+
+void Simulator::place_cubes(okapi::QLength first, okapi::QLength spacing, int count){
+    this->lock();
+    for(int i = 0; i < count; i++){
+        this->cubes.push_back((first + i * spacing).convert(okapi::meter));
+    }
+    this->unlock();
+}
+
+SimulatedPose Simulator::get_pose(){
+    this->lock();
+    SimulatedPose pose = {this->x * okapi::meter, this->y * okapi::meter, this->heading * okapi::radian};
+    this->unlock();
+    return pose;
+}
+
+okapi::QLength Simulator::get_wall_distance(){
+    SimulatedPose pose = this->get_pose();
+    double x = pose.x.convert(okapi::meter);
+    double y = pose.y.convert(okapi::meter);
+    double dx = cos(pose.heading.convert(okapi::radian));
+    double dy = sin(pose.heading.convert(okapi::radian));
+
+    // Distance along the heading to whichever wall it meets first
+    double distance = INFINITY;
+    if(dx > 0) distance = std::min(distance, (FIELD_SIZE - x) / dx);
+    if(dx < 0) distance = std::min(distance, -x / dx);
+    if(dy > 0) distance = std::min(distance, (FIELD_SIZE - y) / dy);
+    if(dy < 0) distance = std::min(distance, -y / dy);
+
+    return std::max(distance - ULTRASONIC_OFFSET, 0.0) * okapi::meter;
+}
+
+int Simulator::get_stacked_cubes(){
+    return this->stacked_cubes;
+}
+
+Simulator *get_simulator(){
+    static Simulator simulator;
+    return &simulator;
+}
@@ -0,0 +1,177 @@
+#include "main.h"
+#include "ui_task.h"
+#include <vector>
+
+const int SUPERVISOR_PERIOD = 20; // ms
+
+// How long every motor has to be clear of faults before a fault's safe state
+// is released
+const std::uint32_t SUPERVISOR_FAULT_HOLD = 1000; // ms
+
+const std::uint32_t SAFE_MOTOR_FAULTS = pros::E_MOTOR_FAULT_DRIVER_FAULT | pros::E_MOTOR_FAULT_DRV_OVER_CURRENT;
+const std::uint32_t LOGGED_MOTOR_FAULTS = SAFE_MOTOR_FAULTS | pros::E_MOTOR_FAULT_MOTOR_OVER_TEMP;
+
+// Heartbeats are only added under the mutex, and the count is stored after
+// the entry, so the supervisor can read them without locking
+Heartbeat *heartbeats[SUPERVISOR_MAX_HEARTBEATS];
+std::atomic<int> heartbeat_count(0);
+
+std::atomic<int> safe_reasons(0);
+std::atomic<std::uint32_t> missed_deadlines(0);
+
+pros::Mutex *get_heartbeat_mutex(){
+    static pros::Mutex mutex;
+    return &mutex;
+}
+
+Heartbeat::Heartbeat(const char *name, std::uint32_t timeout, bool critical): last_beat(0) {
+    this->name = name;
+    this->timeout = timeout;
+    this->critical = critical;
+    this->missed = false;
+
+    pros::Mutex *mutex = get_heartbeat_mutex();
+    mutex->take(TIMEOUT_MAX);
+    int count = heartbeat_count;
+    if(count < SUPERVISOR_MAX_HEARTBEATS){
+        heartbeats[count] = this;
+        heartbeat_count = count + 1;
+    } else {
+        std::cout << "Too many heartbeats, " << name << " won't be watched\n";
+    }
+    mutex->give();
+}
+
+void Heartbeat::beat(){
+    this->last_beat = pros::millis();
+}
+
+void supervisor_deadline_missed(){
+    missed_deadlines++;
+    safe_reasons |= SAFE_DEADLINE;
+}
+
+void supervisor_release(int reasons){
+    safe_reasons &= ~reasons;
+}
+
+int supervisor_safe_reasons(){
+    return safe_reasons;
+}
+
+void supervisor_task_fn(void *param){
+    RobotDeviceInterfaces *robot = (RobotDeviceInterfaces*) param;
+    std::vector<pros::Motor*> motors = robot->get_motors();
+    std::vector<std::uint32_t> motor_faults(motors.size(), 0);
+    std::vector<std::uint32_t> motor_flags(motors.size(), 0);
+
+    UiQueue *log = ui_queue();
+    ProfiledLoop loop("Supervisor", SUPERVISOR_PERIOD);
+
+    std::uint8_t status = pros::competition::get_status();
+    std::uint32_t logged_deadlines = 0;
+    std::uint32_t last_fault = 0;
+    bool was_safe = false;
+
+    while(true){
+        // Each mode runs its own tasks, so heartbeats from the last mode are
+        // forgotten, and so is whatever went wrong in it
+        std::uint8_t new_status = pros::competition::get_status();
+        if(new_status != status){
+            status = new_status;
+            int count = heartbeat_count;
+            for(int i = 0; i < count; i++){
+                heartbeats[i]->last_beat = 0;
+                heartbeats[i]->missed = false;
+            }
+            supervisor_release(SAFE_DEADLINE | SAFE_HEARTBEAT);
+        }
+
+        std::uint32_t deadlines = missed_deadlines;
+        if(deadlines != logged_deadlines){
+            ui_printf(log, "Supervisor: a command missed its deadline");
+            logged_deadlines = deadlines;
+        }
+
+        // Nothing runs while disabled, so nothing can be late
+        bool stalled = false;
+        int count = pros::competition::is_disabled() ? 0 : (int) heartbeat_count;
+        for(int i = 0; i < count; i++){
+            Heartbeat *heartbeat = heartbeats[i];
+
+            // Read before the time, so a beat in between can't look like the
+            // future
+            std::uint32_t last_beat = heartbeat->last_beat;
+            bool late = last_beat != 0 && pros::millis() - last_beat > heartbeat->timeout;
+
+            if(late && !heartbeat->missed){
+                ui_printf(log, "Supervisor: %s stopped", heartbeat->name);
+            } else if(!late && heartbeat->missed){
+                ui_printf(log, "Supervisor: %s running again", heartbeat->name);
+            }
+            heartbeat->missed = late;
+            stalled |= late && heartbeat->critical;
+        }
+
+        if(stalled){
+            safe_reasons |= SAFE_HEARTBEAT;
+        } else {
+            supervisor_release(SAFE_HEARTBEAT);
+        }
+
+        bool faulted = false;
+        for(size_t i = 0; i < motors.size(); i++){
+            std::uint32_t faults = motors[i]->get_faults();
+            std::uint32_t flags = motors[i]->get_flags();
+            if(faults == PROS_ERR || flags == PROS_ERR){
+                continue;
+            }
+
+            faults &= LOGGED_MOTOR_FAULTS;
+            flags &= pros::E_MOTOR_FLAGS_BUSY;
+            if(faults != motor_faults[i] || flags != motor_flags[i]){
+                ui_printf(log, "Supervisor: %s motor faults %#lx flags %#lx", TELEMETRY_MOTOR_NAMES[i],
+                    (unsigned long) faults, (unsigned long) flags);
+                motor_faults[i] = faults;
+                motor_flags[i] = flags;
+            }
+            faulted |= (faults & SAFE_MOTOR_FAULTS) != 0;
+        }
+
+        if(faulted){
+            last_fault = pros::millis();
+            safe_reasons |= SAFE_FAULT;
+        } else if(pros::millis() - last_fault > SUPERVISOR_FAULT_HOLD){
+            supervisor_release(SAFE_FAULT);
+        }
+
+        // The power manager cuts the current while the robot is safe. The
+        // motors are also stopped here so they don't carry on once it's
+        // released.
+        int reasons = safe_reasons;
+        if(reasons != 0 && !was_safe){
+            ui_printf(log, "Supervisor: safe state for%s%s%s",
+                reasons & SAFE_DEADLINE ? " deadline" : "",
+                reasons & SAFE_HEARTBEAT ? " heartbeat" : "",
+                reasons & SAFE_FAULT ? " fault" : "");
+            for(pros::Motor *motor: motors){
+                motor->move_velocity(0);
+            }
+        } else if(reasons == 0 && was_safe){
+            ui_printf(log, "Supervisor: safe state released");
+        }
+        was_safe = reasons != 0;
+
+        loop.wait();
+    }
+}
+
+void supervisor_start(RobotDeviceInterfaces *robot){
+    static pros::Task *task = NULL;
+    if(task == NULL){
+        // Above every task it watches, so it still runs when one of them
+        // never yields
+        task = new pros::Task(supervisor_task_fn, robot, TASK_PRIORITY_MAX - 2,
+            TASK_STACK_DEPTH_DEFAULT, "Supervisor");
+    }
+}
@@ -0,0 +1,201 @@
+#include "main.h"
+#include "display/lvgl.h"
+#include <algorithm>
+
+const char *TELEMETRY_MOTOR_NAMES[TELEMETRY_MOTOR_COUNT] = {
+    "L drive", "R drive", "L arm", "R arm", "Tray", "L roll", "R roll"
+};
+
+// The sampler runs often enough to catch short spikes, but the screen is only
+// redrawn a few times a second. Each redraw plots the min and max of every
+// channel over the window since the last one, so spikes stay visible without
+// plotting every sample.
+const int TELEMETRY_SAMPLE_PERIOD = 10; // ms
+const int TELEMETRY_RENDER_PERIOD = 200; // ms
+const int TELEMETRY_CHART_POINTS = 60;
+
+class DecimatedChannel {
+public:
+    double min, max;
+    int min_index, max_index;
+    int count;
+
+    void add(double value){
+        if(this->count == 0 || value < this->min){
+            this->min = value;
+            this->min_index = this->count;
+        }
+        if(this->count == 0 || value > this->max){
+            this->max = value;
+            this->max_index = this->count;
+        }
+        this->count++;
+    }
+
+    // The extremes are plotted in the order they happened
+    bool min_first() const {
+        return this->min_index <= this->max_index;
+    }
+
+    void reset(){
+        this->count = 0;
+    }
+};
+
+enum TelemetryChannel {
+    CHANNEL_LEFT_DRIVE,
+    CHANNEL_RIGHT_DRIVE,
+    CHANNEL_ARM_SKEW,
+    CHANNEL_COUNT,
+};
+
+// Sampler state, shared between the sampling task and the LVGL render task
+RobotDeviceInterfaces *telemetry_robot = NULL;
+pros::Mutex *telemetry_mutex;
+DecimatedChannel telemetry_channels[CHANNEL_COUNT];
+RobotTelemetry telemetry_latest;
+
+// Dashboard widgets, only touched from the LVGL task
+lv_obj_t *telemetry_screen;
+lv_obj_t *drive_chart, *skew_chart;
+lv_chart_series_t *left_drive_series, *right_drive_series, *skew_series;
+lv_obj_t *tray_gauge;
+lv_obj_t *temperature_labels[TELEMETRY_MOTOR_COUNT];
+lv_obj_t *profile_label;
+
+// Last values drawn, so widgets are only invalidated when what they show changes
+int drawn_tray_angle = -1;
+int drawn_temperatures[TELEMETRY_MOTOR_COUNT];
+int drawn_load = -1, drawn_lateness = -1;
+
+void telemetry_sample_task(void *param){
+    ProfiledLoop loop("Telemetry", TELEMETRY_SAMPLE_PERIOD);
+    RobotTelemetry sample;
+
+    while(true){
+        telemetry_robot->sample_telemetry(&sample);
+        sample.control_load = profiler_load();
+        sample.worst_lateness = profiler_worst_lateness();
+
+        telemetry_mutex->take(TIMEOUT_MAX);
+        telemetry_channels[CHANNEL_LEFT_DRIVE].add(sample.left_drive_velocity);
+        telemetry_channels[CHANNEL_RIGHT_DRIVE].add(sample.right_drive_velocity);
+        telemetry_channels[CHANNEL_ARM_SKEW].add(sample.arm_skew);
+        telemetry_latest = sample;
+        telemetry_mutex->give();
+
+        loop.wait();
+    }
+}
+
+void plot_channel(lv_obj_t *chart, lv_chart_series_t *series, const DecimatedChannel &channel, double scale){
+    if(channel.count == 0){
+        return;
+    }
+
+    lv_coord_t min = channel.min * scale;
+    lv_coord_t max = channel.max * scale;
+
+    lv_chart_set_next(chart, series, channel.min_first() ? min : max);
+    lv_chart_set_next(chart, series, channel.min_first() ? max : min);
+}
+
+void telemetry_render(void *param){
+    DecimatedChannel channels[CHANNEL_COUNT];
+    RobotTelemetry latest;
+
+    telemetry_mutex->take(TIMEOUT_MAX);
+    for(int i = 0; i < CHANNEL_COUNT; i++){
+        channels[i] = telemetry_channels[i];
+        telemetry_channels[i].reset();
+    }
+    latest = telemetry_latest;
+    telemetry_mutex->give();
+
+    plot_channel(drive_chart, left_drive_series, channels[CHANNEL_LEFT_DRIVE], 1);
+    plot_channel(drive_chart, right_drive_series, channels[CHANNEL_RIGHT_DRIVE], 1);
+    lv_chart_refresh(drive_chart);
+
+    // Arm skew is plotted in thousandths of a motor rotation
+    plot_channel(skew_chart, skew_series, channels[CHANNEL_ARM_SKEW], 1000);
+    lv_chart_refresh(skew_chart);
+
+    int tray_angle = latest.tray_angle * 360;
+    if(tray_angle != drawn_tray_angle){
+        lv_gauge_set_value(tray_gauge, 0, tray_angle);
+        drawn_tray_angle = tray_angle;
+    }
+
+    for(int i = 0; i < TELEMETRY_MOTOR_COUNT; i++){
+        int temperature = latest.motor_temperatures[i];
+        if(temperature != drawn_temperatures[i]){
+            char text[32];
+            snprintf(text, sizeof(text), "%s %dC", TELEMETRY_MOTOR_NAMES[i], temperature);
+            lv_label_set_text(temperature_labels[i], text);
+            drawn_temperatures[i] = temperature;
+        }
+    }
+
+    int load = latest.control_load * 100;
+    if(load != drawn_load || (int) latest.worst_lateness != drawn_lateness){
+        char text[32];
+        snprintf(text, sizeof(text), "CPU %d%% late %lums", load, (unsigned long) latest.worst_lateness);
+        lv_label_set_text(profile_label, text);
+        drawn_load = load;
+        drawn_lateness = latest.worst_lateness;
+    }
+}
+
+lv_obj_t *create_chart(lv_obj_t *parent, lv_coord_t y, lv_coord_t min, lv_coord_t max){
+    lv_obj_t *chart = lv_chart_create(parent, NULL);
+    lv_obj_set_size(chart, 300, 110);
+    lv_obj_align(chart, NULL, LV_ALIGN_IN_TOP_LEFT, 5, y);
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_point_count(chart, TELEMETRY_CHART_POINTS);
+    lv_chart_set_range(chart, min, max);
+    lv_chart_set_div_line_count(chart, 3, 0);
+    return chart;
+}
+
+void create_dashboard(){
+    telemetry_screen = lv_obj_create(NULL, NULL);
+
+    drive_chart = create_chart(telemetry_screen, 5, -200, 200);
+    left_drive_series = lv_chart_add_series(drive_chart, LV_COLOR_RED);
+    right_drive_series = lv_chart_add_series(drive_chart, LV_COLOR_BLUE);
+
+    skew_chart = create_chart(telemetry_screen, 125, -250, 250);
+    skew_series = lv_chart_add_series(skew_chart, LV_COLOR_ORANGE);
+
+    tray_gauge = lv_gauge_create(telemetry_screen, NULL);
+    lv_obj_set_size(tray_gauge, 110, 110);
+    lv_obj_align(tray_gauge, NULL, LV_ALIGN_IN_TOP_RIGHT, -35, 5);
+    lv_gauge_set_range(tray_gauge, 0, 100);
+    lv_gauge_set_critical_value(tray_gauge, 85);
+
+    for(int i = 0; i < TELEMETRY_MOTOR_COUNT; i++){
+        temperature_labels[i] = lv_label_create(telemetry_screen, NULL);
+        lv_obj_align(temperature_labels[i], NULL, LV_ALIGN_IN_TOP_LEFT, 315 + (i % 2) * 80, 125 + (i / 2) * 25);
+        lv_label_set_text(temperature_labels[i], TELEMETRY_MOTOR_NAMES[i]);
+        drawn_temperatures[i] = -1;
+    }
+
+    profile_label = lv_label_create(telemetry_screen, NULL);
+    lv_obj_align(profile_label, NULL, LV_ALIGN_IN_TOP_LEFT, 315, 220);
+    lv_label_set_text(profile_label, "");
+}
+
+void telemetry_start(RobotDeviceInterfaces *robot){
+    if(telemetry_robot == NULL){
+        telemetry_robot = robot;
+        telemetry_mutex = new pros::Mutex();
+        create_dashboard();
+
+        // Rendering happens in LVGL's own task, and sampling in the lowest
+        // priority task, so neither can delay the control loop.
+        lv_task_create(telemetry_render, TELEMETRY_RENDER_PERIOD, LV_TASK_PRIO_LOW, NULL);
+        new pros::Task(telemetry_sample_task, NULL, TASK_PRIORITY_MIN, TASK_STACK_DEPTH_DEFAULT, "Telemetry");
+    }
+
+    lv_scr_load(telemetry_screen);
+}
@@ -0,0 +1,100 @@
+#include "main.h"
+#include "ui_task.h"
+#include <stdarg.h>
+
+const int UI_PERIOD = 50; // ms
+
+// Queues and refreshes are only added under the mutex, and each count is
+// stored after its entry, so the UI task can read them without locking
+UiQueue *ui_queues[UI_MAX_QUEUES];
+std::atomic<int> ui_queue_count(0);
+void (*ui_refreshes[UI_MAX_REFRESHES])();
+std::atomic<int> ui_refresh_count(0);
+
+pros::Mutex *get_ui_mutex(){
+    // Created on first use, since queues are asked for from several tasks
+    // during start up
+    static pros::Mutex mutex;
+    return &mutex;
+}
+
+UiQueue *ui_queue(){
+    pros::Mutex *mutex = get_ui_mutex();
+    mutex->take(TIMEOUT_MAX);
+
+    UiQueue *queue = new UiQueue();
+    int count = ui_queue_count;
+    if(count < UI_MAX_QUEUES){
+        ui_queues[count] = queue;
+        ui_queue_count = count + 1;
+    } else {
+        std::cout << "Too many UI queues, one will never be read\n";
+    }
+
+    mutex->give();
+    return queue;
+}
+
+void ui_printf(UiQueue *queue, const char *format, ...){
+    UiItem item;
+    item.work = NULL;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(item.message, sizeof(item.message), format, args);
+    va_end(args);
+
+    queue->push(item);
+}
+
+void ui_defer(UiQueue *queue, void (*work)()){
+    UiItem item;
+    item.work = work;
+    item.message[0] = '\0';
+    queue->push(item);
+}
+
+void ui_add_refresh(void (*refresh)()){
+    pros::Mutex *mutex = get_ui_mutex();
+    mutex->take(TIMEOUT_MAX);
+
+    int count = ui_refresh_count;
+    if(count < UI_MAX_REFRESHES){
+        ui_refreshes[count] = refresh;
+        ui_refresh_count = count + 1;
+    }
+
+    mutex->give();
+}
+
+void ui_task_fn(void *param){
+    ProfiledLoop loop("UI", UI_PERIOD);
+    UiItem item;
+
+    while(true){
+        int queues = ui_queue_count;
+        for(int i = 0; i < queues; i++){
+            while(ui_queues[i]->pop(&item)){
+                if(item.work != NULL){
+                    item.work();
+                } else {
+                    printf("%s\n", item.message);
+                }
+            }
+        }
+
+        int refreshes = ui_refresh_count;
+        for(int i = 0; i < refreshes; i++){
+            ui_refreshes[i]();
+        }
+
+        loop.wait();
+    }
+}
+
+void ui_task_start(){
+    static pros::Task *task = NULL;
+    if(task == NULL){
+        task = new pros::Task(ui_task_fn, NULL, TASK_PRIORITY_MIN + 1, TASK_STACK_DEPTH_DEFAULT, "UI");
+    }
+}
@@ -0,0 +1,131 @@
+#include "main.h"
+#include "okapi/api/filter/medianFilter.hpp"
+#include <algorithm>
+#include <math.h>
+
+// The ultrasonic pings about every 50ms, so sampling faster only repeats
+// readings into the filter
+const std::uint32_t WALL_SAMPLE_PERIOD = 50; // ms
+
+// Approach speed is the distance error times this gain, up to the drive's free
+// speed
+const double WALL_APPROACH_GAIN = 3; // per second
+const okapi::QLength WALL_TOLERANCE = 0.5 * okapi::inch;
+
+// How long to wait for the first good reading before driving open loop
+const std::uint32_t WALL_READING_TIMEOUT = 300; // ms
+
+// Missed echoes leave the last approach speed applied, so the approach gives
+// up and stops if it goes this much past the fallback distance or takes too
+// long. The timeout is inside the block deadline, so a lost wall ends the
+// approach rather than tripping the supervisor.
+const okapi::QLength WALL_TRAVEL_MARGIN = 6 * okapi::inch;
+const std::uint32_t WALL_APPROACH_TIMEOUT = 3000; // ms
+
+UltrasonicDistanceSensor::UltrasonicDistanceSensor(std::uint8_t ping_port, std::uint8_t echo_port):
+    ultrasonic(ping_port, echo_port) {}
+
+okapi::QLength UltrasonicDistanceSensor::get_distance(){
+    // Readings are in centimetres, or 0 when there is no echo. A failed read
+    // is PROS_ERR, which is INT32_MAX, and counts as a missed echo too.
+    std::int32_t value = this->ultrasonic.get_value();
+    if(value == PROS_ERR){
+        return 0_in;
+    }
+    return std::max(value, 0) * okapi::centimeter;
+}
+
+SimulatedUltrasonic::SimulatedUltrasonic(std::function<okapi::QLength()> truth, int dropout_period){
+    this->truth = truth;
+    this->dropout_period = dropout_period;
+    this->readings = 0;
+}
+
+okapi::QLength SimulatedUltrasonic::get_distance(){
+    this->readings++;
+    if(this->dropout_period > 0 && this->readings % this->dropout_period == 0){
+        return 0_in;
+    }
+    return round(this->truth().convert(okapi::centimeter)) * okapi::centimeter;
+}
+
+class WallApproachBlockCommand: public BlockCommand {
+private:
+    RobotDeviceInterfaces *robot;
+    okapi::QLength standoff, fallback;
+    okapi::QLength start_distance;
+    okapi::MedianFilter<5> filter;
+    std::uint32_t start_time, sample_time;
+    bool has_reading;
+    BlockCommand *open_loop;
+
+public:
+    // The approach speed is set here, so the command has to be blocked on to
+    // drive
+    virtual bool check() override {
+        if(this->open_loop != NULL){
+            return this->open_loop->check();
+        }
+
+        std::uint32_t now = pros::millis();
+        if(this->robot->wall == NULL
+                || (!this->has_reading && now - this->start_time > WALL_READING_TIMEOUT)){
+            std::cout << "No wall reading, driving the approach open loop\n";
+            this->open_loop = this->robot->straight_drive->move_distance(this->fallback);
+            return false;
+        }
+
+        okapi::QLength travelled = this->robot->straight_drive->get_distance() - this->start_distance;
+        bool too_far = fabs(travelled.convert(okapi::inch))
+            > fabs(this->fallback.convert(okapi::inch)) + WALL_TRAVEL_MARGIN.convert(okapi::inch);
+        if(too_far || now - this->start_time > WALL_APPROACH_TIMEOUT){
+            std::cout << "Wall approach " << (too_far ? "went too far" : "timed out") << ", stopping\n";
+            this->robot->straight_drive->move_velocity(0_rpm);
+            return true;
+        }
+
+        if(now - this->sample_time < WALL_SAMPLE_PERIOD){
+            return false;
+        }
+        this->sample_time = now;
+
+        okapi::QLength distance = this->robot->wall->get_distance();
+        if(distance.getValue() <= 0){
+            // Missed echoes are left out of the filter entirely
+            return false;
+        }
+        if(!this->has_reading){
+            // Fill the filter so the first outputs aren't pulled towards zero
+            for(int i = 0; i < 4; i++){
+                this->filter.filter(distance.convert(okapi::meter));
+            }
+            this->has_reading = true;
+        }
+
+        okapi::QLength error = this->filter.filter(distance.convert(okapi::meter)) * okapi::meter - this->standoff;
+        if(fabs(error.convert(okapi::inch)) < WALL_TOLERANCE.convert(okapi::inch)){
+            this->robot->straight_drive->move_velocity(0_rpm);
+            return true;
+        }
+
+        double max = this->robot->straight_drive->get_max_linear_velocity().convert(okapi::mps);
+        double velocity = std::clamp(WALL_APPROACH_GAIN * error.convert(okapi::meter), -max, max);
+        this->robot->straight_drive->move_linear_velocity(velocity * okapi::mps);
+        return false;
+    }
+
+    WallApproachBlockCommand(RobotDeviceInterfaces *robot, okapi::QLength standoff, okapi::QLength fallback){
+        this->robot = robot;
+        this->standoff = standoff;
+        this->fallback = fallback;
+        this->start_distance = robot->straight_drive->get_distance();
+        this->start_time = pros::millis();
+        this->sample_time = 0;
+        this->has_reading = false;
+        this->open_loop = NULL;
+    }
+};
+
+BlockCommand *approach_wall(RobotDeviceInterfaces *robot, okapi::QLength standoff, okapi::QLength fallback){
+    return new WallApproachBlockCommand(robot, standoff, fallback);
+}